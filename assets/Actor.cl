@@ -1,20 +1,52 @@
 #include "Actor.h"
+#include "Parameters.h"
+#include "Spawn.h"
+#include "Telemetry.h"
 
-#include "Common.cl"
-#include "Random.cl"
+#include "Common.h"
+#include "Random.h"
 
 bool printSizeof = true;
 
-float evaluateCell(struct Cell *cell)
+// Sum of what the fine samples from `from` to `to`, every 3 cells along `v`, would sense, read from the pyramid level
+// whose blocks are about a quarter of the distance: one sample per block, weighted by the fine samples it stands for.
+float senseCoarse(__global const float *pyramid, int2 boardSize, float2 pos, float2 v, int from, int to)
 {
-    return cell->solid * -10.f + cell->trail;
+    float sum = 0;
+    for (int j = from; j <= to;)
+    {
+        const int level = clamp(ilogb(j / 4.f), 2, PYRAMID_LEVELS);
+        const int block = 1 << level;
+        const int2 at = toInt2(pos + v * (j + block / 2.f)) >> level;
+        const int2 size = pyramidSize(boardSize, level);
+        const float value = at.x < 0 || at.x >= size.x || at.y < 0 || at.y >= size.y
+                ? -10.f : pyramid[pyramidOffset(boardSize, level) + (size_t)size.x * at.y + at.x];
+        sum += value * min(block, to - j + 1) / 3.f;
+        j += block;
+    }
+    return sum;
 }
 
+// With `deterministic`, trail is deposited into `deposits` in fixed point instead of straight onto the board, which
+// leaves the board unchanged while the actors sense it. diffuse() in Board.cl adds the deposits. With `tileFlags`, the
+// tile of every deposit is flagged active for the sparse board pass.
 kernel
 void actor(__global struct Cell* board, int2 boardSize, __global struct Actor* actors, int actorSize,
-           int generation)
+           __global const int *generationCounter, __global const struct Parameters *parameters,
+           __global int *deposits, int deterministic, __global int *tileFlags, __global const float *pyramid,
+           int pyramidFrom)
 {
-    const int id = get_global_id(0);
+    // Dimension 1 is the ensemble member. Each member has its own board and a block of actorSize actors.
+    const int member = get_global_id(1);
+    const struct Parameters p = parameters[member];
+    if (get_global_id(0) >= p.actorCount)
+        return;
+
+    const size_t id = (size_t)member * actorSize + get_global_id(0);
+    const int generation = *generationCounter;
+    board += (size_t)member * boardSize.x * boardSize.y;
+    if (pyramid)
+        pyramid += (size_t)member * pyramidOffset(boardSize, PYRAMID_LEVELS + 1);
     struct Actor *a = &actors[id];
 
     if (printSizeof && id == 0)
@@ -33,11 +65,11 @@ void actor(__global struct Cell* board, int2 boardSize, __global struct Actor* a
 
         const float2 directionVector = (float2)(cos(a->direction), sin(a->direction));
 
-        const float maxTurn = 0.05;
-        const int senseMin = 30;
-        const int senseMax = 40;
-        const float senseAngle = 90. * (float)M_PI / 180.;
-        const int senseSteps = convert_int_rte(senseMax * senseAngle / 3);
+        const float maxTurn = p.maxTurn;
+        const int senseMin = p.senseMin;
+        const int senseMax = p.senseMax;
+        const float senseAngle = p.senseAngle * (float)M_PI / 180.f;
+        const int senseSteps = min(convert_int_rte(senseMax * senseAngle / 3), 999);
         const float senseIncrement = senseAngle / senseSteps;
         float senseStart = -senseAngle / 2.f;
         float senseArray[1000];
@@ -48,11 +80,16 @@ void actor(__global struct Cell* board, int2 boardSize, __global struct Actor* a
             const float2 v = rotateVector(directionVector, dir);
             senseArray[i] = -fabs(dir);
             senseDirArray[i] = dir;
-            for (int j = senseMin; j <= senseMax; j += 3)
+            // With a pyramid, samples from pyramidFrom on come from its coarse levels.
+            const int fineMax = pyramid ? min(senseMax, max(pyramidFrom, senseMin) - 1) : senseMax;
+            int j = senseMin;
+            for (; j <= fineMax; j += 3)
             {
                 const float2 vx = v * (float2)(j, j);
                 senseArray[i] += evaluateCell(cellF(board, boardSize,  a->pos + vx));
             }
+            if (pyramid && j <= senseMax)
+                senseArray[i] += senseCoarse(pyramid, boardSize, a->pos, v, j, senseMax);
         }
         float maxSense = -INFINITY;
         float senseDir = 0;
@@ -68,8 +105,8 @@ void actor(__global struct Cell* board, int2 boardSize, __global struct Actor* a
 
         struct Cell *ahead = cellF(board, boardSize, a->pos + rotateVector((float2)(50, 0), a->direction));
 
-        a->direction = rndNormalF(generation * 31337 + id, a->direction + senseDir, 0.05);
-        a->speed = rndNormalF(generation * 7789 + id, a->speed * .99f + a->targetSpeed * .01f, 0.01);
+        a->direction = rndNormalF(generation * 31337 + (int)id, a->direction + senseDir, 0.05);
+        a->speed = rndNormalF(generation * 7789 + (int)id, a->speed * .99f + a->targetSpeed * .01f, 0.01);
         float2 speedVector = (float2)(cos(a->direction), sin(a->direction)) * a->speed;
         float2 next = a->pos + speedVector;
         int2 nextI = toInt2(next);
@@ -89,7 +126,163 @@ void actor(__global struct Cell* board, int2 boardSize, __global struct Actor* a
             a->pos = next;
         }
 
-        cellF(board, boardSize, a->pos)->trail += a->speed * 2;
+        const int2 at = toInt2(a->pos);
+        const bool inside = at.x >= 0 && at.x < boardSize.x && at.y >= 0 && at.y < boardSize.y;
+        if (deterministic && inside)
+        {
+            deposits += (size_t)member * boardSize.x * boardSize.y;
+            __global int *deposit = &deposits[(size_t)boardSize.x * at.y + at.x];
+            const int amount = convert_int_rte(a->speed * 2 * DEPOSIT_SCALE);
+            // Saturating add: whoever passes the limit clamps after adding, so the cell ends at min(sum, limit)
+            // whatever the order.
+            if (atomic_add(deposit, amount) > DEPOSIT_LIMIT - amount)
+                atomic_min(deposit, DEPOSIT_LIMIT);
+        }
+        else if (!deterministic)
+            cellF(board, boardSize, a->pos)->trail += a->speed * 2;
+        // Every actor of a tile stores the same value, so the race is harmless.
+        if (tileFlags && inside)
+            tileFlags[(size_t)member * tilesPerBoard(boardSize) + tileOf(boardSize, at)] = 1;
+    }
+}
+
+
+// Spawns the actors of every member in the region given by shape, center and extent, see Spawn.h. Actors beyond a
+// member's actorCount are dead. The random numbers come from a counter based generator keyed by `seed`, so an actor
+// only depends on the seed, its member and its index.
+kernel
+void initActors(__global struct Actor* actors, int actorSize, __global const struct Parameters *parameters,
+                __global struct Cell* board, int2 boardSize, int shape, float2 center, float2 extent, ulong seed)
+{
+    const int index = get_global_id(0);
+    const int member = get_global_id(1);
+    if (index >= actorSize)
+        return;
+
+    const uint2 key = (uint2)((uint)seed, (uint)(seed >> 32));
+    struct Actor *a = &actors[(size_t)member * actorSize + index];
+    const uint4 r = philox((uint4)(index, member, 0, 0), key);
+
+    a->alive = index < parameters[member].actorCount;
+    a->speed = 0;
+    a->targetSpeed = rndNormalBits(r.x, r.y, .5f, .1f);
+    a->direction = rndUnit(r.z) * 2 * M_PI_F;
+    a->pos = center;
+
+    if (shape == SPAWN_DISC)
+    {
+        const uint4 p = philox((uint4)(index, member, 1, 0), key);
+        const float radius = extent.x * sqrt(rndUnit(p.x));
+        const float theta = rndUnit(p.y) * 2 * M_PI_F;
+        a->pos = center + radius * (float2)(cos(theta), sin(theta));
+    }
+    else if (shape == SPAWN_BOX)
+    {
+        const uint4 p = philox((uint4)(index, member, 1, 0), key);
+        a->pos = center + ((float2)(rndUnit(p.x), rndUnit(p.y)) * 2 - 1) * extent;
+    }
+    else
+    {
+        // Rejection sampling against the solid cells. An actor that finds no free cell stays dead.
+        board += (size_t)member * boardSize.x * boardSize.y;
+        bool placed = false;
+        for (uint attempt = 0; attempt < 64 && !placed; ++attempt)
+        {
+            const uint4 p = philox((uint4)(index, member, 1, attempt), key);
+            const float2 pos = (float2)(rndUnit(p.x) * boardSize.x, rndUnit(p.y) * boardSize.y);
+            if (!cellF(board, boardSize, pos)->solid)
+            {
+                a->pos = pos;
+                placed = true;
+            }
+        }
+        a->alive = a->alive && placed;
+    }
+}
+
+// Actor pass of the telemetry, laid out like reduceCells() in Board.cl.
+kernel __attribute__((reqd_work_group_size(TELEMETRY_GROUP_SIZE, 1, 1)))
+void reduceActors(__global const struct Actor* actors, int actorSize, __global struct TelemetryPartial *partials)
+{
+    __local int aliveActors[TELEMETRY_GROUP_SIZE];
+    __local float speedSums[TELEMETRY_GROUP_SIZE];
+
+    const int lid = get_local_id(0);
+    const int member = get_global_id(1);
+    actors += (size_t)member * actorSize;
+    int aliveCount = 0;
+    float speedSum = 0;
+    for (int i = get_global_id(0); i < actorSize; i += get_global_size(0))
+    {
+        if (!actors[i].alive)
+            continue;
+        ++aliveCount;
+        speedSum += actors[i].speed;
+    }
+    aliveActors[lid] = aliveCount;
+    speedSums[lid] = speedSum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = TELEMETRY_GROUP_SIZE / 2; stride > 0; stride /= 2)
+    {
+        if (lid < stride)
+        {
+            aliveActors[lid] += aliveActors[lid + stride];
+            speedSums[lid] += speedSums[lid + stride];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+    {
+        __global struct TelemetryPartial *partial = &partials[member * TELEMETRY_GROUPS + get_group_id(0)];
+        partial->aliveActors = aliveActors[0];
+        partial->speedSum = speedSums[0];
     }
 }
 
+// Strip decomposition, see StripRunner: takes the alive actors outside the rows [owned.x, owned.y) of this strip's
+// board out of it, into `transfer` for the host to hand to the strip that owns them now. Without room left in
+// `transfer` an actor stays and leaves a generation later. Without `transfer` the actors are only killed, which keeps
+// the ones a freshly spawned strip owns.
+kernel
+void emigrate(__global struct Actor* actors, int actorSize, int2 owned, __global struct Actor* transfer,
+              __global int *transferCount, int transferCapacity)
+{
+    const int index = get_global_id(0);
+    if (index >= actorSize || !actors[index].alive)
+        return;
+    const int y = toInt2(actors[index].pos).y;
+    if (y >= owned.x && y < owned.y)
+        return;
+
+    if (transfer)
+    {
+        const int slot = atomic_inc(transferCount);
+        if (slot >= transferCapacity)
+            return;
+        transfer[slot] = actors[index];
+    }
+    actors[index].alive = false;
+}
+
+// Puts the `count` actors of `arriving` into dead slots. `taken` has to be zero. Their last deposit went into the
+// sender's halo, which the owner's rows overwrite, so it is repeated on `board`, after this strip's blur.
+kernel
+void immigrate(__global struct Actor* actors, int actorSize, __global struct Cell* board, int2 boardSize,
+               __global const struct Actor* arriving, int count, volatile __global int *taken)
+{
+    const int index = get_global_id(0);
+    if (index < count)
+    {
+        const int2 at = toInt2(arriving[index].pos);
+        if (at.x >= 0 && at.x < boardSize.x && at.y >= 0 && at.y < boardSize.y)
+            cell(board, boardSize, at)->trail += arriving[index].speed * 2;
+    }
+    // The plain read spares most dead slots the atomic once everyone has a place.
+    if (index >= actorSize || actors[index].alive || *taken >= count)
+        return;
+    const int k = atomic_inc(taken);
+    if (k < count)
+        actors[index] = arriving[k];
+}
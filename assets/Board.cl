@@ -1,13 +1,51 @@
-#include "Common.cl"
+#include "Common.h"
+#include "Parameters.h"
+#include "Telemetry.h"
+
+// Cell of this work-item in the board passes. Dense launches cover the board with their global ids. Sparse launches,
+// with `tiles`, run a TILE_SIZE x TILE_SIZE work-group for every slot of the member's list of active tiles, see
+// compactTiles(). False for slots beyond the list and for cells outside the board.
+bool boardCell(int2 size, __global const int *tiles, __global const int *tileCounts, int2 *coords)
+{
+    const int member = get_global_id(2);
+    if (tiles)
+    {
+        const int slot = get_group_id(1);
+        if (slot >= tileCounts[member])
+            return false;
+        const int tile = tiles[(size_t)member * tilesPerBoard(size) + slot];
+        *coords = (int2)(tile % tilesPerRow(size), tile / tilesPerRow(size)) * TILE_SIZE
+                + (int2)(get_local_id(0), get_local_id(1));
+    }
+    else
+        *coords = (int2)(get_global_id(0), get_global_id(1));
+    return coords->x < size.x && coords->y < size.y;
+}
+
+// Keeps the tile of `coords` active for the next generation while its trail is not negligible.
+void keepActive(int2 size, __global int *nextTileFlags, int2 coords, float trail)
+{
+    if (nextTileFlags && trail >= TILE_ACTIVE_TRAIL)
+        nextTileFlags[(size_t)get_global_id(2) * tilesPerBoard(size) + tileOf(size, coords)] = 1;
+}
 
 kernel
-void board(write_only image2d_t out, __global struct Cell* board, int2 size)
+void board(__global struct Cell* board, int2 size, __global int *generationCounter,
+           __global const struct Parameters *parameters, __global const int *tiles, __global const int *tileCounts,
+           __global int *nextTileFlags)
 {
-    const int gx = get_global_id(0);
-    const int gy = get_global_id(1);
-    const int2 coords = (int2)(gx, gy);
+    const int member = get_global_id(2);
+
+    // The board pass closes a generation. Keeping the counter on the device lets a frame be replayed without
+    // touching kernel arguments.
+    if (get_global_id(0) == 0 && get_global_id(1) == 0 && member == 0)
+        ++*generationCounter;
 
-    if (gx < size.x && gy < size.y)
+    const struct Parameters p = parameters[member];
+    board += (size_t)member * size.x * size.y;
+
+    int2 coords;
+    if (boardCell(size, tiles, tileCounts, &coords))
     {
         struct Cell *c = cell(board, size, coords);
 
@@ -22,30 +60,311 @@ void board(write_only image2d_t out, __global struct Cell* board, int2 size)
         neighbors[7] = cell(board, size, coords + (int2)( 0,  1));
         neighbors[8] = cell(board, size, coords + (int2)( 1,  1));
 
-        const float p1 = 1.f / 128.f;
-        const float p2 = 4.f / 128.f;
-        const float p4 = 108.f / 128.f;
-        const float fader = 0.99f;
+        const float p1 = p.diffusionCorner;
+        const float p2 = p.diffusionEdge;
+        const float p4 = p.diffusionCenter;
+        const float fader = p.fader;
         c->trail = fader * (neighbors[0]->trail * p1 + neighbors[1]->trail * p2 + neighbors[2]->trail * p1
                           + neighbors[3]->trail * p2 + neighbors[4]->trail * p4 + neighbors[5]->trail * p2
                           + neighbors[6]->trail * p1 + neighbors[7]->trail * p2 + neighbors[8]->trail * p1);
+        keepActive(size, nextTileFlags, coords, c->trail);
+    }
+}
+
+// Trail of a cell plus the deposits of this generation, 0 outside the board like cell().
+float depositedTrail(__global const struct Cell* board, __global const int *deposits, int2 size, int2 coords)
+{
+    if (coords.x < 0 || coords.x >= size.x || coords.y < 0 || coords.y >= size.y)
+        return 0;
+    const size_t i = (size_t)size.x * coords.y + coords.x;
+    return board[i].trail + deposits[i] / DEPOSIT_SCALE;
+}
+
+// Deterministic counterpart of board(): blurs the board and the deposits of actor() into `next` without touching
+// the board, so no work-item sees a neighbour's new value. commitTrail() then moves the result onto the board. Both
+// run dense or sparse like board().
+kernel
+void diffuse(__global const struct Cell* board, int2 size, __global const int *deposits,
+             __global const struct Parameters *parameters, __global float *next, __global const int *tiles,
+             __global const int *tileCounts)
+{
+    const int member = get_global_id(2);
+    int2 c;
+    if (!boardCell(size, tiles, tileCounts, &c))
+        return;
+
+    const struct Parameters p = parameters[member];
+    const size_t offset = (size_t)member * size.x * size.y;
+    board += offset;
+    deposits += offset;
+
+    const float p1 = p.diffusionCorner;
+    const float p2 = p.diffusionEdge;
+    const float p4 = p.diffusionCenter;
+    next[offset + (size_t)size.x * c.y + c.x] = p.fader * (
+            depositedTrail(board, deposits, size, c + (int2)(-1, -1)) * p1
+          + depositedTrail(board, deposits, size, c + (int2)( 0, -1)) * p2
+          + depositedTrail(board, deposits, size, c + (int2)( 1, -1)) * p1
+          + depositedTrail(board, deposits, size, c + (int2)(-1,  0)) * p2
+          + depositedTrail(board, deposits, size, c) * p4
+          + depositedTrail(board, deposits, size, c + (int2)( 1,  0)) * p2
+          + depositedTrail(board, deposits, size, c + (int2)(-1,  1)) * p1
+          + depositedTrail(board, deposits, size, c + (int2)( 0,  1)) * p2
+          + depositedTrail(board, deposits, size, c + (int2)( 1,  1)) * p1);
+}
+
+// Second half of a deterministic generation: takes the trail diffuse() computed and clears the deposits. Closes the
+// generation like board().
+kernel
+void commitTrail(__global struct Cell* board, int2 size, __global const float *next, __global int *deposits,
+                 __global int *generationCounter, __global const int *tiles, __global const int *tileCounts,
+                 __global int *nextTileFlags)
+{
+    const int member = get_global_id(2);
+    if (get_global_id(0) == 0 && get_global_id(1) == 0 && member == 0)
+        ++*generationCounter;
+    int2 c;
+    if (!boardCell(size, tiles, tileCounts, &c))
+        return;
+
+    const size_t i = (size_t)member * size.x * size.y + (size_t)size.x * c.y + c.x;
+    board[i].trail = next[i];
+    deposits[i] = 0;
+    keepActive(size, nextTileFlags, c, next[i]);
+}
+
+// Lists the active tiles of every member for the sparse board pass: those flagged by actor() or, through
+// keepActive(), by the previous board pass, and their neighbours, which the blur spreads into. One work-item per tile;
+// the order of the list does not matter. `tileCounts` has to be zero, finishTiles() leaves it so.
+kernel
+void compactTiles(int2 size, __global const int *tileFlags, __global int *tiles, __global int *tileCounts)
+{
+    const int2 t = (int2)(get_global_id(0), get_global_id(1));
+    const int member = get_global_id(2);
+    const int2 tileSize = (int2)(tilesPerRow(size), tilesPerBoard(size) / tilesPerRow(size));
+    if (t.x >= tileSize.x || t.y >= tileSize.y)
+        return;
+
+    const size_t offset = (size_t)member * tilesPerBoard(size);
+    bool active = false;
+    for (int y = max(t.y - 1, 0); y <= min(t.y + 1, tileSize.y - 1) && !active; ++y)
+        for (int x = max(t.x - 1, 0); x <= min(t.x + 1, tileSize.x - 1) && !active; ++x)
+            active = tileFlags[offset + tileSize.x * y + x] != 0;
+    if (active)
+        tiles[offset + atomic_inc(&tileCounts[member])] = tileSize.x * t.y + t.x;
+}
 
+// Closes the sparse pass of a generation: the tiles the board pass kept active become the flags actor() adds to, and
+// the lists are emptied for the next compactTiles().
+kernel
+void finishTiles(int2 size, __global int *tileFlags, __global int *nextTileFlags, __global int *tileCounts)
+{
+    const int2 t = (int2)(get_global_id(0), get_global_id(1));
+    const int member = get_global_id(2);
+    const int2 tileSize = (int2)(tilesPerRow(size), tilesPerBoard(size) / tilesPerRow(size));
+    if (t.x == 0 && t.y == 0)
+        tileCounts[member] = 0;
+    if (t.x >= tileSize.x || t.y >= tileSize.y)
+        return;
+
+    const size_t i = (size_t)member * tilesPerBoard(size) + tileSize.x * t.y + t.x;
+    tileFlags[i] = nextTileFlags[i];
+    nextTileFlags[i] = 0;
+}
+
+// Rebuilds the trail pyramid of every member from the board, see Pyramid.h, when the generation is a multiple of
+// `interval`. One work-item per level 1 cell; the one at the corner of a block of a coarser level averages that block
+// as well, straight from the board, which avoids a launch per level.
+kernel
+void buildPyramid(__global struct Cell* board, int2 size, __global const int *generationCounter, int interval,
+                  __global float *pyramid)
+{
+    if (*generationCounter % interval != 0)
+        return;
+    const int2 c = (int2)(get_global_id(0), get_global_id(1));
+    const int member = get_global_id(2);
+    if (c.x >= pyramidSize(size, 1).x || c.y >= pyramidSize(size, 1).y)
+        return;
+
+    board += (size_t)member * size.x * size.y;
+    pyramid += (size_t)member * pyramidOffset(size, PYRAMID_LEVELS + 1);
+    for (int level = 1; level <= PYRAMID_LEVELS; ++level)
+    {
+        const int factor = 1 << (level - 1);
+        if (c.x % factor != 0 || c.y % factor != 0)
+            break;
+        const int block = 1 << level;
+        const int2 at = c / factor;
+        float sum = 0;
+        for (int y = 0; y < block; ++y)
+            for (int x = 0; x < block; ++x)
+                sum += evaluateCell(cell(board, size, at * block + (int2)(x, y)));
+        const int2 levelSize = pyramidSize(size, level);
+        pyramid[pyramidOffset(size, level) + (size_t)levelSize.x * at.y + at.x] = sum / (block * block);
+    }
+}
 
-        float4 color;
+// Draws the visible part of one member's board at screen resolution: output pixel (x, y) shows the cell under
+// origin + (x + .5, y + .5) * scale. Runs once per frame, so its cost depends on the window, not the board.
+kernel
+void colorize(write_only image2d_t out, __global struct Cell* board, int2 size, int member, float2 origin,
+              float scale)
+{
+    const int gx = get_global_id(0);
+    const int gy = get_global_id(1);
+    if (gx >= get_image_width(out) || gy >= get_image_height(out))
+        return;
+
+    board += (size_t)member * size.x * size.y;
+    const float2 position = origin + ((float2)(gx, gy) + .5f) * scale;
+    const int2 coords = convert_int2(floor(position));
+
+    float4 color = (float4)(0, 0, 0, 0);
+    if (coords.x >= 0 && coords.x < size.x && coords.y >= 0 && coords.y < size.y)
+    {
+        const struct Cell *c = cell(board, size, coords);
         if (c->solid)
         {
             color = (float4)(.2, .2, .2, 0);
         }
-        else
-        {
-            color = (float4)(0, 0, 0, 0);
-        }
-
 
         const float4 trailColor = (float4)(c->trail / 10.f, c->trail / 500.f, c->trail / 1000.f, 0);
         float trail = clamp(c->trail, 0.f, 1.f);
         color = color * (1.f - trail) + trailColor * trail;
+    }
 
-        write_imagef(out, (int2)(gx, gy), color);
+    write_imagef(out, (int2)(gx, gy), color);
+}
+
+// Empty board with a solid border that grows towards the corners, for every member. Replaces filling the board on
+// the host and uploading it.
+kernel
+void initBoard(__global struct Cell* board, int2 size, int top, int height)
+{
+    const int gx = get_global_id(0);
+    const int gy = get_global_id(1);
+    const int member = get_global_id(2);
+    if (gx >= size.x || gy >= size.y)
+        return;
+
+    // Solid where 1/dx + 1/dy > 1/10, in integers to stay exact on large boards. The board holds rows from `top` on
+    // of one `height` rows high.
+    const long dx = min(gx, size.x - gx);
+    const long dy = min(gy + top, height - gy - top);
+    struct Cell *c = board + (size_t)member * size.x * size.y + (size_t)gy * size.x + gx;
+    c->solid = dx == 0 || dy == 0 || 10 * (dx + dy) > dx * dy;
+    c->trail = 0;
+}
+
+// Telemetry histogram bin of a trail, see Telemetry.h.
+int trailBin(float trail)
+{
+    if (!(trail >= 1.f / 256))
+        return 0;
+    return min(convert_int(floor(log2(trail))) + 9, TELEMETRY_BINS - 1);
+}
+
+// First pass of the telemetry: each work-group sums a strided share of one member's cells into its partial.
+// Dimension 0 holds TELEMETRY_GROUPS groups, dimension 1 is the member.
+kernel __attribute__((reqd_work_group_size(TELEMETRY_GROUP_SIZE, 1, 1)))
+void reduceCells(__global const struct Cell* board, int2 size, float coverageThreshold,
+                 __global struct TelemetryPartial *partials)
+{
+    __local float trailSums[TELEMETRY_GROUP_SIZE];
+    __local float trailMaxima[TELEMETRY_GROUP_SIZE];
+    __local int freeCells[TELEMETRY_GROUP_SIZE];
+    __local int coveredCells[TELEMETRY_GROUP_SIZE];
+    __local int histogram[TELEMETRY_BINS];
+
+    const int lid = get_local_id(0);
+    const int member = get_global_id(1);
+    if (lid < TELEMETRY_BINS)
+        histogram[lid] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    board += (size_t)member * size.x * size.y;
+    const size_t count = (size_t)size.x * size.y;
+    float trailSum = 0;
+    float trailMax = 0;
+    int freeCount = 0;
+    int coveredCount = 0;
+    for (size_t i = get_global_id(0); i < count; i += get_global_size(0))
+    {
+        const float trail = board[i].trail;
+        trailSum += trail;
+        trailMax = fmax(trailMax, trail);
+        if (board[i].solid)
+            continue;
+        ++freeCount;
+        coveredCount += trail > coverageThreshold;
+        atomic_inc(&histogram[trailBin(trail)]);
     }
+    trailSums[lid] = trailSum;
+    trailMaxima[lid] = trailMax;
+    freeCells[lid] = freeCount;
+    coveredCells[lid] = coveredCount;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = TELEMETRY_GROUP_SIZE / 2; stride > 0; stride /= 2)
+    {
+        if (lid < stride)
+        {
+            trailSums[lid] += trailSums[lid + stride];
+            trailMaxima[lid] = fmax(trailMaxima[lid], trailMaxima[lid + stride]);
+            freeCells[lid] += freeCells[lid + stride];
+            coveredCells[lid] += coveredCells[lid + stride];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    __global struct TelemetryPartial *partial = &partials[member * TELEMETRY_GROUPS + get_group_id(0)];
+    if (lid == 0)
+    {
+        partial->trailSum = trailSums[0];
+        partial->trailMax = trailMaxima[0];
+        partial->freeCells = freeCells[0];
+        partial->coveredCells = coveredCells[0];
+    }
+    if (lid < TELEMETRY_BINS)
+        partial->histogram[lid] = histogram[lid];
+}
+
+// Second pass of the telemetry, one work-item per member: adds up the partials of reduceCells() and reduceActors().
+kernel
+void finishTelemetry(__global const struct TelemetryPartial *partials, __global const int *generationCounter,
+                     __global struct Telemetry *telemetry, int members)
+{
+    const int member = get_global_id(0);
+    if (member >= members)
+        return;
+
+    partials += member * TELEMETRY_GROUPS;
+    __global struct Telemetry *t = &telemetry[member];
+    float trailSum = 0;
+    float trailMax = 0;
+    int freeCells = 0;
+    int coveredCells = 0;
+    int aliveActors = 0;
+    float speedSum = 0;
+    for (int bin = 0; bin < TELEMETRY_BINS; ++bin)
+        t->histogram[bin] = 0;
+    for (int group = 0; group < TELEMETRY_GROUPS; ++group)
+    {
+        __global const struct TelemetryPartial *p = &partials[group];
+        trailSum += p->trailSum;
+        trailMax = fmax(trailMax, p->trailMax);
+        freeCells += p->freeCells;
+        coveredCells += p->coveredCells;
+        aliveActors += p->aliveActors;
+        speedSum += p->speedSum;
+        for (int bin = 0; bin < TELEMETRY_BINS; ++bin)
+            t->histogram[bin] += p->histogram[bin];
+    }
+
+    t->generation = *generationCounter;
+    t->aliveActors = aliveActors;
+    t->meanSpeed = aliveActors > 0 ? speedSum / aliveActors : 0;
+    t->totalTrail = trailSum;
+    t->maxTrail = trailMax;
+    t->coverage = freeCells > 0 ? (float)coveredCells / freeCells : 0;
 }
@@ -1,6 +1,4 @@
-#pragma once
-
-#include "Cell.h"
+#include "Common.h"
 
 int toInt(float v)
 {
@@ -18,7 +16,8 @@ struct Cell *cell(struct Cell* board, int2 boardSize, int2 coordinates)
 {
     if (coordinates.x < 0 || coordinates.x >= boardSize.x || coordinates.y < 0 || coordinates.y >= boardSize.y)
         return &edgeCell;
-    return &board[coordinates.x + boardSize.x * coordinates.y];
+    // size_t, boards may have more than 2^31 cells.
+    return &board[(size_t)boardSize.x * coordinates.y + coordinates.x];
 }
 
 struct Cell *cellF(struct Cell* board, int2 boardSize, float2 coordinates)
@@ -26,6 +25,39 @@ struct Cell *cellF(struct Cell* board, int2 boardSize, float2 coordinates)
     return cell(board, boardSize, toInt2(coordinates));
 }
 
+float evaluateCell(struct Cell *cell)
+{
+    return cell->solid * -10.f + cell->trail;
+}
+
+int2 pyramidSize(int2 boardSize, int level)
+{
+    return (boardSize + (1 << level) - 1) >> level;
+}
+
+size_t pyramidOffset(int2 boardSize, int level)
+{
+    size_t offset = 0;
+    for (int l = 1; l < level; ++l)
+        offset += (size_t)pyramidSize(boardSize, l).x * pyramidSize(boardSize, l).y;
+    return offset;
+}
+
+int tilesPerRow(int2 boardSize)
+{
+    return (boardSize.x + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+int tilesPerBoard(int2 boardSize)
+{
+    return tilesPerRow(boardSize) * ((boardSize.y + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+int tileOf(int2 boardSize, int2 coordinates)
+{
+    return tilesPerRow(boardSize) * (coordinates.y / TILE_SIZE) + coordinates.x / TILE_SIZE;
+}
+
 float2 rotateVector(float2 vec, float rad)
 {
     return (float2)(vec.x * cos(rad) - vec.y * sin(rad), vec.x * sin(rad) + vec.y * cos(rad));
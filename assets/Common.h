@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Cell.h"
+#include "Pyramid.h"
+#include "Tiles.h"
+
+// Scale of the fixed point trail deposits of the deterministic mode. Integer additions give the same sum in any order.
+// The deposits of a cell in one generation saturate at DEPOSIT_LIMIT, a trail of 262144 or some 250000 actors at
+// the default speed. The headroom above it absorbs the adds racing with the clamp, see actor().
+#define DEPOSIT_SCALE 4096.f
+#define DEPOSIT_LIMIT (1 << 30)
+
+// Implemented in Common.cl, which is compiled once and linked into every program.
+
+int toInt(float v);
+
+int2 toInt2(float2 v);
+
+struct Cell *cell(struct Cell* board, int2 boardSize, int2 coordinates);
+
+struct Cell *cellF(struct Cell* board, int2 boardSize, float2 coordinates);
+
+// What an actor senses in a cell: its trail, walls repel.
+float evaluateCell(struct Cell *cell);
+
+// Size of pyramid level `level` and where it starts in a member's pyramid, see Pyramid.h. A member's pyramid holds
+// pyramidOffset(boardSize, PYRAMID_LEVELS + 1) floats.
+int2 pyramidSize(int2 boardSize, int level);
+size_t pyramidOffset(int2 boardSize, int level);
+
+// Tiles per row and per board, and index of the tile holding `coordinates`, see Tiles.h.
+int tilesPerRow(int2 boardSize);
+int tilesPerBoard(int2 boardSize);
+int tileOf(int2 boardSize, int2 coordinates);
+
+float2 rotateVector(float2 vec, float rad);
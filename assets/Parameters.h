@@ -0,0 +1,15 @@
+#pragma once
+
+// Per ensemble member simulation parameters. Shared between host and device, so only 4 byte members.
+struct Parameters
+{
+    float maxTurn;
+    float senseAngle;
+    int senseMin;
+    int senseMax;
+    float fader;
+    float diffusionCenter;
+    float diffusionEdge;
+    float diffusionCorner;
+    int actorCount;
+};
@@ -0,0 +1,32 @@
+#include "Peak.h"
+
+// Microbenchmarks for the device peaks of the roofline report, see Roofline.h.
+
+// Streams three arrays of n floats: 12 bytes and 2 flops per element.
+kernel
+void triad(__global float *a, __global const float *b, __global const float *c, float s, int n)
+{
+    const int i = get_global_id(0);
+    if (i < n)
+        a[i] = b[i] + s * c[i];
+}
+
+// 2 * PEAK_CHAINS * PEAK_ITERATIONS flops per work-item without touching memory in between. The chains are
+// independent, so latency does not limit them.
+kernel
+void arithmetic(__global float *out, float a, float b)
+{
+    float x[PEAK_CHAINS];
+    for (int c = 0; c < PEAK_CHAINS; ++c)
+        x[c] = get_global_id(0) + c;
+    for (int i = 0; i < PEAK_ITERATIONS; ++i)
+    {
+#pragma unroll
+        for (int c = 0; c < PEAK_CHAINS; ++c)
+            x[c] = mad(x[c], a, b);
+    }
+    float sum = 0;
+    for (int c = 0; c < PEAK_CHAINS; ++c)
+        sum += x[c];
+    out[get_global_id(0)] = sum;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Independent multiply-add chains per work-item of arithmetic() in Peak.cl, and their length.
+#define PEAK_CHAINS 8
+#define PEAK_ITERATIONS 256
@@ -0,0 +1,5 @@
+#pragma once
+
+// Coarse levels of the trail pyramid for long-range sensing. Level l, from 1 to PYRAMID_LEVELS, holds the mean of
+// evaluateCell() over blocks of 2^l x 2^l cells, so a far sensor sample reads one value instead of many cells.
+#define PYRAMID_LEVELS 5
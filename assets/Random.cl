@@ -1,3 +1,4 @@
+#include "Random.h"
 
 uint rnd(uint seed)
 {
@@ -27,3 +28,29 @@ float rndNormalF(int seed, float mu, float sigma)
     const float magnitude = sigma * sqrt(-2.0f * log(u1));
     return magnitude * cos(2.0 * M_PI * u2) + mu;
 }
+
+uint4 philox(uint4 counter, uint2 key)
+{
+    for (int round = 0; round < 10; ++round)
+    {
+        const uint hi0 = mul_hi(0xD2511F53u, counter.x);
+        const uint lo0 = 0xD2511F53u * counter.x;
+        const uint hi1 = mul_hi(0xCD9E8D57u, counter.z);
+        const uint lo1 = 0xCD9E8D57u * counter.z;
+        counter = (uint4)(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += (uint2)(0x9E3779B9u, 0xBB67AE85u);
+    }
+    return counter;
+}
+
+float rndUnit(uint bits)
+{
+    return (bits >> 8) * (1.f / 16777216.f);
+}
+
+float rndNormalBits(uint bits1, uint bits2, float mu, float sigma)
+{
+    // 1 - rndUnit() is in (0, 1], which keeps the log finite.
+    const float magnitude = sigma * sqrt(-2.f * log(1.f - rndUnit(bits1)));
+    return magnitude * cos(2.f * M_PI_F * rndUnit(bits2)) + mu;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Implemented in Random.cl, which is compiled once and linked into every program.
+
+uint rnd(uint seed);
+
+float rndUniform(int seed, int min, int max);
+
+float rndUniformF(int seed, float min, float max);
+
+float rndNormalF(int seed, float mu, float sigma);
+
+// Counter based generator (Philox4x32-10): four independent random words for every distinct counter and key.
+uint4 philox(uint4 counter, uint2 key);
+
+// Uniform in [0, 1) from 24 random bits.
+float rndUnit(uint bits);
+
+// Normal distribution from two random words.
+float rndNormalBits(uint bits1, uint bits2, float mu, float sigma);
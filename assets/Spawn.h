@@ -0,0 +1,12 @@
+#pragma once
+
+// Shapes of the region actors are spawned in, see initActors() in Actor.cl.
+enum SpawnShape
+{
+    // Uniform in the disc of radius extent.x around center.
+    SPAWN_DISC = 0,
+    // Uniform in the box center +- extent.
+    SPAWN_BOX = 1,
+    // Uniform over the cells of the member's board that are not solid.
+    SPAWN_MASK = 2
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+// Bins of the trail histogram: bin 0 counts free cells with a trail below 2^-8, bin i those in [2^(i-9), 2^(i-8)),
+// the last bin everything above.
+#define TELEMETRY_BINS 32
+// The reductions run TELEMETRY_GROUPS work-groups of TELEMETRY_GROUP_SIZE per member.
+#define TELEMETRY_GROUPS 64
+#define TELEMETRY_GROUP_SIZE 256
+
+// Result of one work-group of the telemetry reductions. reduceCells() fills the trail fields, reduceActors() the
+// actor fields. Shared between host and device, so only 4 byte members.
+struct TelemetryPartial
+{
+    float trailSum;
+    float trailMax;
+    int freeCells;
+    int coveredCells;
+    int histogram[TELEMETRY_BINS];
+    int aliveActors;
+    float speedSum;
+};
+
+// Summary of one ensemble member, reduced on the device so only these numbers are read back.
+struct Telemetry
+{
+    int generation;
+    int aliveActors;
+    float meanSpeed;
+    // Over all cells, like Statistics.
+    float totalTrail;
+    float maxTrail;
+    // Fraction of free cells with a trail above the coverage threshold.
+    float coverage;
+    int histogram[TELEMETRY_BINS];
+};
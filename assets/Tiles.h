@@ -0,0 +1,7 @@
+#pragma once
+
+// Side of the square tiles of the sparse board pass, which blurs only active tiles: those with actors or with a trail
+// above TILE_ACTIVE_TRAIL, and their neighbours. A tile is one work-group.
+#define TILE_SIZE 8
+// Trail below which a cell counts as empty, like bin 0 of the telemetry histogram. Such trails are no longer blurred.
+#define TILE_ACTIVE_TRAIL (1.f / 256)
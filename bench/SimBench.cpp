@@ -0,0 +1,295 @@
+// Headless benchmark of the per generation kernels over a matrix of board sizes, actor counts and work-group sizes,
+// on every OpenCL device found. Writes one CSV line per device and configuration, so kernel variants can be
+// compared between commits and machines.
+
+#include "Exception.h"
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "ParameterTable.h"
+#include "ProgramBuilder.h"
+#include "ProgramCache.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "assets/Parameters.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct BenchSettings
+{
+    std::vector<int> boardSizes{1024, 2048, 4096, 8192, 16384};
+    std::vector<int> actorCounts{10000, 100000, 1000000, 10000000};
+    std::vector<int> actorLocals{16, 64, 256};
+    std::vector<int2> boardLocals{{8, 8}, {16, 16}, {32, 8}};
+    // Timed generations per configuration, after as many untimed ones.
+    int generations = 20;
+    // Sparse board passes, see Simulation::setSparse().
+    bool sparse = false;
+    // Sensor distance from which the trail pyramid is used, 0 for none, see Simulation::setPyramid().
+    int pyramidFrom = 0;
+    // Only devices whose name contains this.
+    std::string device;
+    std::string output = "sim_bench.csv";
+};
+
+std::string usage()
+{
+    return "Usage: sim_bench [options]\n"
+           "  --boards=N,...      square board sizes (default 1024,2048,4096,8192,16384)\n"
+           "  --actors=N,...      actor counts (default 10000,100000,1000000,10000000)\n"
+           "  --actor-local=N,... work-group sizes of the actor kernel (default 16,64,256)\n"
+           "  --board-local=XxY,...\n"
+           "                      work-group sizes of the board kernel (default 8x8,16x16,32x8)\n"
+           "  --generations=N     timed generations per configuration (default 20)\n"
+           "  --sparse=on|off     blur only active tiles (default off)\n"
+           "  --pyramid=D         sense from distance D on in the trail pyramid (default: not at all)\n"
+           "  --device=NAME       only devices whose name contains NAME (default: all, including CPU runtimes)\n"
+           "  --output=FILE       CSV file with one line per device and configuration (default sim_bench.csv)\n";
+}
+
+int parsePositive(const std::string &name, const std::string &value)
+{
+    std::istringstream in(value);
+    int result = 0;
+    in >> result;
+    if (value.empty() || in.fail() || !in.eof() || result < 1)
+        throw Exception(fmt::format("Invalid value '{}' for option --{}", value, name));
+    return result;
+}
+
+std::vector<std::string> split(const std::string &value, char separator)
+{
+    std::vector<std::string> parts;
+    std::istringstream in(value);
+    for (std::string part; std::getline(in, part, separator);)
+        parts.push_back(part);
+    return parts;
+}
+
+std::vector<int> parseList(const std::string &name, const std::string &value)
+{
+    std::vector<int> list;
+    for (const std::string &part : split(value, ','))
+        list.push_back(parsePositive(name, part));
+    if (list.empty())
+        throw Exception(fmt::format("--{} needs at least one value", name));
+    return list;
+}
+
+std::vector<int2> parseShapes(const std::string &name, const std::string &value)
+{
+    std::vector<int2> shapes;
+    for (const std::string &part : split(value, ','))
+    {
+        const std::vector<std::string> xy = split(part, 'x');
+        if (xy.size() != 2)
+            throw Exception(fmt::format("Invalid value '{}' for option --{}, expected XxY", part, name));
+        shapes.push_back({parsePositive(name, xy[0]), parsePositive(name, xy[1])});
+    }
+    if (shapes.empty())
+        throw Exception(fmt::format("--{} needs at least one value", name));
+    return shapes;
+}
+
+BenchSettings parse(int argc, char **argv)
+{
+    BenchSettings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const std::size_t separator = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || separator == std::string::npos)
+            throw Exception(fmt::format("Unexpected argument '{}'", arg));
+        const std::string name = arg.substr(2, separator - 2);
+        const std::string value = arg.substr(separator + 1);
+        if (name == "boards")
+            settings.boardSizes = parseList(name, value);
+        else if (name == "actors")
+            settings.actorCounts = parseList(name, value);
+        else if (name == "actor-local")
+            settings.actorLocals = parseList(name, value);
+        else if (name == "board-local")
+            settings.boardLocals = parseShapes(name, value);
+        else if (name == "generations")
+            settings.generations = parsePositive(name, value);
+        else if (name == "sparse")
+        {
+            if (value != "on" && value != "off")
+                throw Exception(fmt::format("Invalid value '{}' for option --{}, expected on or off", value, name));
+            settings.sparse = value == "on";
+        }
+        else if (name == "pyramid")
+            settings.pyramidFrom = parsePositive(name, value);
+        else if (name == "device")
+            settings.device = value;
+        else if (name == "output")
+            settings.output = value;
+        else
+            throw Exception(fmt::format("Unknown option --{}", name));
+    }
+    return settings;
+}
+
+std::vector<cl::Device> allDevices()
+{
+    std::vector<cl::Device> devices;
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const cl::Platform &platform : platforms)
+    {
+        std::vector<cl::Device> platformDevices;
+        try
+        {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices);
+        }
+        catch (const cl::Error &)
+        {
+            continue; // CL_DEVICE_NOT_FOUND
+        }
+        devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    return devices;
+}
+
+std::string quoted(std::string text)
+{
+    std::replace(text.begin(), text.end(), '"', '\'');
+    return '"' + text + '"';
+}
+
+std::string csvHeader()
+{
+    return "device,boardSize,actors,actorLocal,boardLocalX,boardLocalY,generations,"
+           "actorP50Ms,actorP95Ms,actorP99Ms,actorsPerSecond,boardP50Ms,boardP95Ms,boardP99Ms,cellsPerSecond,status";
+}
+
+std::string csv(const Profiler::Summary &s)
+{
+    return fmt::format("{},{},{},{}", s.p50 * 1e3, s.p95 * 1e3, s.p99 * 1e3, s.throughput);
+}
+
+// Runs the whole matrix on `device`, every configuration from the same freshly spawned state.
+void benchDevice(const BenchSettings &settings, const cl::Device &device, std::ostream &output)
+{
+    const std::string name = device.getInfo<CL_DEVICE_NAME>();
+    std::cout << fmt::format("Benchmarking {}", name) << std::endl;
+
+    cl::Context context(device);
+    const ProgramCache programCache(ProgramCache::defaultDirectory());
+    ProgramBuilder programBuilder(context, device, programCache);
+    const std::shared_future<cl::Program> boardBuild = programBuilder.build(embeddedSource("Board.cl"));
+    const std::shared_future<cl::Program> actorBuild = programBuilder.build(embeddedSource("Actor.cl"));
+    Profiler profiler;
+    Simulation simulation(context, device, cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE),
+                          boardBuild.get(), actorBuild.get());
+    simulation.setProfiler(&profiler);
+    simulation.setSparse(settings.sparse);
+    simulation.setPyramid(settings.pyramidFrom, 4);
+
+    for (const int boardSize : settings.boardSizes)
+        for (const int actorCount : settings.actorCounts)
+            for (const int actorLocal : settings.actorLocals)
+                for (const int2 boardLocal : settings.boardLocals)
+                {
+                    const std::string configuration = fmt::format("{},{},{},{},{},{},{}", quoted(name), boardSize,
+                                                                  actorCount, actorLocal, boardLocal.x,
+                                                                  boardLocal.y, settings.generations);
+                    Profiler::Summary actor;
+                    Profiler::Summary board;
+                    std::string status = "ok";
+                    try
+                    {
+                        Parameters parameters = defaultParameters();
+                        parameters.actorCount = actorCount;
+                        const int2 size{boardSize, boardSize};
+                        // A fixed seed makes every device and commit simulate the same population.
+                        simulation.reset(size, {parameters}, 1, SpawnRegion::centered(SPAWN_DISC, size));
+                        simulation.setLaunchShape({actorLocal, boardLocal});
+                        simulation.step(settings.generations);
+                        simulation.queue().finish();
+                        profiler.poll(true);
+                        profiler.reset();
+
+                        simulation.step(settings.generations);
+                        profiler.poll(true);
+                        actor = profiler.summary("actor");
+                        board = profiler.summary("board");
+                    }
+                    catch (const cl::Error &error)
+                    {
+                        status = fmt::format("{}({})", error.what(), error.err());
+                    }
+                    catch (const Exception &e)
+                    {
+                        status = e.what();
+                    }
+                    profiler.poll(true);
+                    profiler.reset();
+                    output << fmt::format("{},{},{},{}", configuration, csv(actor), csv(board), quoted(status))
+                           << std::endl;
+                    std::cout << fmt::format("  {}x{}, {} actors, local {} and {}x{}: {}", boardSize, boardSize,
+                                             actorCount, actorLocal, boardLocal.x, boardLocal.y, status)
+                              << std::endl;
+                }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    BenchSettings settings;
+    try
+    {
+        settings = parse(argc, argv);
+    }
+    catch (const Exception &e)
+    {
+        std::cerr << e.what() << "\n" << usage();
+        return 2;
+    }
+
+    std::ofstream output(settings.output);
+    if (!output)
+    {
+        std::cerr << fmt::format("Unable to write {}", settings.output) << std::endl;
+        return 1;
+    }
+    output << csvHeader() << std::endl;
+
+    int benchmarked = 0;
+    for (const cl::Device &device : allDevices())
+    {
+        if (device.getInfo<CL_DEVICE_NAME>().find(settings.device) == std::string::npos)
+            continue;
+        try
+        {
+            benchDevice(settings, device, output);
+            ++benchmarked;
+        }
+        catch (const cl::Error &error)
+        {
+            std::cerr << fmt::format("{}: {}({}), device skipped", device.getInfo<CL_DEVICE_NAME>(), error.what(),
+                                     error.err()) << std::endl;
+        }
+        catch (const Exception &e)
+        {
+            std::cerr << fmt::format("{}: {}, device skipped", device.getInfo<CL_DEVICE_NAME>(), e.what())
+                      << std::endl;
+        }
+    }
+    if (benchmarked == 0)
+    {
+        std::cerr << "No OpenCL device could be benchmarked" << std::endl;
+        return 1;
+    }
+    return 0;
+}
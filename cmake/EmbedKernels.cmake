@@ -0,0 +1,89 @@
+# Embeds the device program sources and shaders of ASSETS_DIR into OUTPUT as C++ string constants. Quoted #includes
+# are inlined recursively, honoring #pragma once, so that the programs build without any include path.
+#
+# Usage: cmake -D ASSETS_DIR=<dir> -D OUTPUT=<file.cpp> -P EmbedKernels.cmake
+
+cmake_minimum_required(VERSION 3.16.1)
+
+function(resolve_includes file result)
+    get_filename_component(file "${file}" REALPATH)
+    get_property(included GLOBAL PROPERTY EMBED_INCLUDED)
+    if("${file}" IN_LIST included)
+        set(${result} "" PARENT_SCOPE)
+        return()
+    endif()
+    set_property(GLOBAL APPEND PROPERTY EMBED_INCLUDED "${file}")
+
+    file(READ "${file}" content)
+    string(REGEX REPLACE "#[ \t]*pragma[ \t]+once[^\n]*\n?" "" content "${content}")
+    get_filename_component(dir "${file}" DIRECTORY)
+    string(REGEX MATCHALL "#[ \t]*include[ \t]*\"[^\"]+\"" directives "${content}")
+    foreach(directive IN LISTS directives)
+        string(REGEX REPLACE "#[ \t]*include[ \t]*\"([^\"]+)\"" "\\1" name "${directive}")
+        if(EXISTS "${dir}/${name}")
+            set(path "${dir}/${name}")
+        elseif(EXISTS "${ASSETS_DIR}/${name}")
+            set(path "${ASSETS_DIR}/${name}")
+        else()
+            message(FATAL_ERROR "${file}: cannot resolve #include \"${name}\"")
+        endif()
+        resolve_includes("${path}" inlined)
+        # Only the first occurrence, later ones are covered by #pragma once.
+        string(FIND "${content}" "${directive}" position)
+        string(LENGTH "${directive}" length)
+        string(SUBSTRING "${content}" 0 ${position} before)
+        math(EXPR after_start "${position} + ${length}")
+        string(SUBSTRING "${content}" ${after_start} -1 after)
+        set(content "${before}${inlined}${after}")
+    endforeach()
+    set(${result} "${content}" PARENT_SCOPE)
+endfunction()
+
+file(GLOB sources "${ASSETS_DIR}/*.cl" "${ASSETS_DIR}/*.vert" "${ASSETS_DIR}/*.frag")
+list(SORT sources)
+
+set(entries "")
+foreach(source IN LISTS sources)
+    set_property(GLOBAL PROPERTY EMBED_INCLUDED "")
+    resolve_includes("${source}" content)
+    get_filename_component(name "${source}" NAME)
+    string(SHA256 digest "${content}")
+    string(SUBSTRING "${digest}" 0 16 hash)
+
+    # Split into pieces, string literals have length limits on some compilers.
+    set(literal "")
+    string(LENGTH "${content}" remaining)
+    set(offset 0)
+    while(remaining GREATER 0)
+        string(SUBSTRING "${content}" ${offset} 8000 piece)
+        string(APPEND literal "\n        R\"__source__(${piece})__source__\"")
+        math(EXPR offset "${offset} + 8000")
+        math(EXPR remaining "${remaining} - 8000")
+    endwhile()
+    if(literal STREQUAL "")
+        set(literal "\"\"")
+    endif()
+    string(APPEND entries "    {\"${name}\",${literal},\n        0x${hash}ull},\n")
+endforeach()
+
+set(generated "// Generated by cmake/EmbedKernels.cmake from ${ASSETS_DIR}, do not edit.
+
+#include \"ProgramSource.h\"
+
+const std::vector<ProgramSource> &embeddedSources()
+{
+    static const std::vector<ProgramSource> sources =
+    {
+${entries}    };
+    return sources;
+}
+")
+
+# Keep the timestamp if nothing changed, so that dependent objects are not rebuilt.
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" previous)
+    if(previous STREQUAL generated)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${generated}")
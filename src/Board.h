@@ -4,6 +4,8 @@
 
 #include <vector>
 
+// Host side board, for starting a simulation from a custom map. The default board is generated on the device, see
+// Simulation::reset().
 class Board
 {
 public:
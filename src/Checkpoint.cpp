@@ -0,0 +1,249 @@
+#include "Checkpoint.h"
+
+#include "Exception.h"
+#include "ParameterTable.h"
+#include "Simulation.h"
+#include "assets/Actor.h"
+#include "assets/Cell.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+const char checkpointMagic[8] = {'S', 'L', 'I', 'M', 'E', 'C', 'K', 'P'};
+const std::uint32_t checkpointVersion = 1;
+const std::uint64_t sectionAlignment = 4096;
+
+static_assert(sizeof(CheckpointHeader) == 80, "CheckpointHeader has padding");
+
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+}
+
+CheckpointWriter::CheckpointWriter(const cl::Context &context, bool announce) :
+    m_context(context),
+    m_announce(announce),
+    m_thread(&CheckpointWriter::run, this)
+{ }
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+bool CheckpointWriter::save(const Simulation &simulation, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_busy)
+        return false;
+
+    const int2 boardSize = simulation.boardSize();
+    const std::size_t cellsSize = static_cast<std::size_t>(boardSize.x) * boardSize.y * simulation.members()
+                                  * sizeof(Cell);
+    const std::size_t actorsSize = static_cast<std::size_t>(simulation.actorsPerMember()) * simulation.members()
+                                   * sizeof(Actor);
+    ensureStaging(m_cells, m_cellsCapacity, cellsSize);
+    ensureStaging(m_actors, m_actorsCapacity, std::max<std::size_t>(actorsSize, 1));
+
+    Job job;
+    job.queue = simulation.queue();
+    job.parameters = simulation.parameters();
+    job.path = path;
+
+    CheckpointHeader &header = job.header;
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.cellSize = sizeof(Cell);
+    header.actorSize = sizeof(Actor);
+    header.parametersSize = sizeof(Parameters);
+    header.boardWidth = boardSize.x;
+    header.boardHeight = boardSize.y;
+    header.members = simulation.members();
+    header.actorsPerMember = simulation.actorsPerMember();
+    header.generation = simulation.generation();
+    header.parametersOffset = alignUp(sizeof(CheckpointHeader));
+    header.cellsOffset = alignUp(header.parametersOffset + sizeof(Parameters) * job.parameters.size());
+    header.actorsOffset = alignUp(header.cellsOffset + cellsSize);
+    header.fileSize = header.actorsOffset + actorsSize;
+
+    // Copies on the device are cheap and let the simulation go on while the copies are read back.
+    job.queue.enqueueCopyBuffer(simulation.cells(), m_cells, 0, 0, cellsSize);
+    job.mapped.emplace_back();
+    job.cells = job.queue.enqueueMapBuffer(m_cells, CL_FALSE, CL_MAP_READ, 0, cellsSize, nullptr,
+                                           &job.mapped.back());
+    if (actorsSize > 0)
+    {
+        job.queue.enqueueCopyBuffer(simulation.actors(), m_actors, 0, 0, actorsSize);
+        job.mapped.emplace_back();
+        job.actors = job.queue.enqueueMapBuffer(m_actors, CL_FALSE, CL_MAP_READ, 0, actorsSize, nullptr,
+                                                &job.mapped.back());
+    }
+    job.queue.flush();
+
+    m_job = std::move(job);
+    m_busy = true;
+    m_condition.notify_all();
+    return true;
+}
+
+void CheckpointWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return !m_busy; });
+}
+
+void CheckpointWriter::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_condition.wait(lock, [this]() { return m_job || m_stop; });
+        if (!m_job)
+            return;
+
+        const Job job = std::move(*m_job);
+        m_job.reset();
+        lock.unlock();
+
+        cl::Event::waitForEvents(job.mapped);
+        write(job);
+        // The staging buffers are reused for the next checkpoint, which is enqueued after these.
+        job.queue.enqueueUnmapMemObject(m_cells, job.cells);
+        if (job.actors)
+            job.queue.enqueueUnmapMemObject(m_actors, job.actors);
+        job.queue.flush();
+
+        lock.lock();
+        m_busy = false;
+        m_condition.notify_all();
+    }
+}
+
+void CheckpointWriter::write(const Job &job) const
+{
+    const CheckpointHeader &header = job.header;
+    const std::string temporary = job.path + ".tmp";
+    try
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw Exception(fmt::format("cannot open {}", temporary));
+
+        auto writeAt = [&out](std::uint64_t offset, const void *data, std::size_t size)
+        {
+            const std::vector<char> padding(offset - static_cast<std::uint64_t>(out.tellp()), 0);
+            out.write(padding.data(), padding.size());
+            out.write(static_cast<const char *>(data), size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.parametersOffset, job.parameters.data(), sizeof(Parameters) * job.parameters.size());
+        // Only what was mapped, the padding up to the actors comes with them.
+        const std::size_t cellsSize = static_cast<std::size_t>(header.boardWidth) * header.boardHeight * header.members
+                                      * sizeof(Cell);
+        writeAt(header.cellsOffset, job.cells, cellsSize);
+        writeAt(header.actorsOffset, job.actors, header.fileSize - header.actorsOffset);
+        out.close();
+        if (!out)
+            throw Exception(fmt::format("writing {} failed", temporary));
+
+        // Replaces the previous checkpoint only with a complete one.
+        fs::rename(temporary, job.path);
+        if (m_announce)
+            std::cout << fmt::format("Checkpoint of generation {} written to {}", header.generation, job.path)
+                      << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << fmt::format("Unable to write checkpoint {}: {}", job.path, e.what()) << std::endl;
+    }
+}
+
+void CheckpointWriter::ensureStaging(cl::Buffer &buffer, std::size_t &capacity, std::size_t size)
+{
+    if (size <= capacity)
+        return;
+    cl_int errCode;
+    buffer = cl::Buffer(m_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, nullptr, &errCode);
+    if (errCode != CL_SUCCESS)
+        throw Exception(fmt::format("Failed to allocate {} bytes of checkpoint staging memory: {}", size, errCode));
+    capacity = size;
+}
+
+Checkpoint::Checkpoint(const std::string &path) :
+    m_file(path)
+{
+    if (m_file.size() < sizeof(CheckpointHeader))
+        throw Exception(fmt::format("{} is not a checkpoint", path));
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (std::memcmp(m_header.magic, checkpointMagic, sizeof(checkpointMagic)) != 0)
+        throw Exception(fmt::format("{} is not a checkpoint", path));
+    if (m_header.version != checkpointVersion)
+        throw Exception(fmt::format("{} has checkpoint version {}, expected {}", path, m_header.version,
+                                    checkpointVersion));
+    if (m_header.cellSize != sizeof(Cell) || m_header.actorSize != sizeof(Actor)
+            || m_header.parametersSize != sizeof(Parameters))
+        throw Exception(fmt::format("{} was written with different Cell, Actor or Parameters layouts", path));
+    if (m_header.fileSize != m_file.size())
+        throw Exception(fmt::format("{} is truncated: {} of {} bytes", path, m_file.size(), m_header.fileSize));
+    if (m_header.boardWidth < 1 || m_header.boardHeight < 1 || m_header.members < 1 || m_header.actorsPerMember < 0)
+        throw Exception(fmt::format("{} has an invalid board or ensemble size", path));
+
+    const std::uint64_t cellsSize = std::uint64_t(m_header.boardWidth) * m_header.boardHeight * m_header.members
+                                    * sizeof(Cell);
+    const std::uint64_t actorsSize = std::uint64_t(m_header.actorsPerMember) * m_header.members * sizeof(Actor);
+    if (m_header.parametersOffset + sizeof(Parameters) * m_header.members > m_header.cellsOffset
+            || m_header.cellsOffset + cellsSize > m_header.actorsOffset
+            || m_header.actorsOffset + actorsSize != m_header.fileSize)
+        throw Exception(fmt::format("{} has inconsistent section offsets", path));
+
+    m_parameters.resize(m_header.members);
+    std::memcpy(m_parameters.data(), m_file.data() + m_header.parametersOffset,
+                sizeof(Parameters) * m_parameters.size());
+    int actorsPerMember = 0;
+    for (const Parameters &p : m_parameters)
+    {
+        validate(p);
+        actorsPerMember = std::max(actorsPerMember, p.actorCount);
+    }
+    if (actorsPerMember != m_header.actorsPerMember)
+        throw Exception(fmt::format("{} has {} actors per member, its parameters need {}", path,
+                                    m_header.actorsPerMember, actorsPerMember));
+}
+
+int2 Checkpoint::boardSize() const
+{
+    return {m_header.boardWidth, m_header.boardHeight};
+}
+
+int Checkpoint::generation() const
+{
+    return static_cast<int>(m_header.generation);
+}
+
+const std::vector<Parameters> &Checkpoint::parameters() const
+{
+    return m_parameters;
+}
+
+void Checkpoint::restore(Simulation &simulation) const
+{
+    simulation.restore(boardSize(), m_parameters, generation(), m_file.data() + m_header.cellsOffset,
+                       m_file.data() + m_header.actorsOffset);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "assets/Parameters.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Simulation;
+
+// Start of a checkpoint file. The parameters, cells and actors follow as raw device data at page aligned offsets, so
+// a mapped file can be uploaded without copying. Layout sizes are recorded to reject files of other builds.
+struct CheckpointHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t cellSize;
+    std::uint32_t actorSize;
+    std::uint32_t parametersSize;
+    std::int32_t boardWidth;
+    std::int32_t boardHeight;
+    std::int32_t members;
+    std::int32_t actorsPerMember;
+    std::int64_t generation;
+    std::uint64_t parametersOffset;
+    std::uint64_t cellsOffset;
+    std::uint64_t actorsOffset;
+    // Detects truncated files.
+    std::uint64_t fileSize;
+};
+
+// Saves the full state of a simulation without stalling it. The buffers are copied on the device into staging
+// buffers, which are mapped without blocking; a background thread writes them out once the mapping completes.
+class CheckpointWriter
+{
+public:
+    // With `announce`, every completed checkpoint is reported on stdout; failures always are.
+    explicit CheckpointWriter(const cl::Context &context, bool announce = true);
+    // Finishes the checkpoint being written.
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Checkpoints `simulation` as of the commands enqueued so far into `path`, replacing it only once the new file is
+    // complete. Returns false without doing anything while the previous checkpoint is still being written.
+    bool save(const Simulation &simulation, const std::string &path);
+    // Blocks until the current checkpoint is on disk.
+    void wait();
+
+private:
+    struct Job
+    {
+        CheckpointHeader header;
+        std::vector<Parameters> parameters;
+        cl::CommandQueue queue;
+        std::vector<cl::Event> mapped;
+        void *cells = nullptr;
+        void *actors = nullptr;
+        std::string path;
+    };
+
+    void run();
+    void write(const Job &job) const;
+    void ensureStaging(cl::Buffer &buffer, std::size_t &capacity, std::size_t size);
+
+    cl::Context m_context;
+    bool m_announce;
+    cl::Buffer m_cells;
+    std::size_t m_cellsCapacity = 0;
+    cl::Buffer m_actors;
+    std::size_t m_actorsCapacity = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::optional<Job> m_job;
+    bool m_busy = false;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+// A checkpoint file, mapped into memory and validated.
+class Checkpoint
+{
+public:
+    // Throws Exception if `path` is not a checkpoint this build can restore.
+    explicit Checkpoint(const std::string &path);
+
+    [[nodiscard]] int2 boardSize() const;
+    [[nodiscard]] int generation() const;
+    [[nodiscard]] const std::vector<Parameters> &parameters() const;
+
+    // Uploads the saved state into `simulation`, straight from the mapped file.
+    void restore(Simulation &simulation) const;
+
+private:
+    MappedFile m_file;
+    CheckpointHeader m_header{};
+    std::vector<Parameters> m_parameters;
+};
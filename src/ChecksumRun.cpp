@@ -0,0 +1,90 @@
+#include "ChecksumRun.h"
+
+#include "Checkpoint.h"
+#include "Exception.h"
+#include "KeyframeStore.h"
+#include "OpenCLUtil.h"
+#include "ProgramBuilder.h"
+#include "ProgramCache.h"
+#include "Simulation.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+
+// Generations recorded into one frame sequence, as in sweeps.
+const int generationsPerReplay = 100;
+
+const int defaultBoardWidth = 1024;
+const int defaultBoardHeight = 1024;
+
+}
+
+int runChecksum(const Settings &settings, const std::vector<Parameters> &members, const Checkpoint *checkpoint)
+{
+    std::vector<cl::Device> devices;
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const cl::Platform &platform : platforms)
+    {
+        std::vector<cl::Device> platformDevices;
+        try
+        {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices);
+        }
+        catch (const cl::Error &)
+        {
+            continue; // CL_DEVICE_NOT_FOUND
+        }
+        devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    if (devices.empty())
+        throw Exception("No OpenCL devices found");
+
+    const int2 boardSize{settings.boardWidth ? settings.boardWidth : defaultBoardWidth,
+                         settings.boardHeight ? settings.boardHeight : defaultBoardHeight};
+    const std::uint64_t seed = settings.seed.value_or(1);
+    int failed = 0;
+    for (const cl::Device &device : devices)
+    {
+        const std::string name = device.getInfo<CL_DEVICE_NAME>();
+        try
+        {
+            cl::Context context(device);
+            const ProgramCache programCache(settings.programCache.value_or(ProgramCache::defaultDirectory()));
+            ProgramBuilder programBuilder(context, device, programCache);
+            const std::shared_future<cl::Program> boardBuild = programBuilder.build(embeddedSource("Board.cl"));
+            const std::shared_future<cl::Program> actorBuild = programBuilder.build(embeddedSource("Actor.cl"));
+            Simulation simulation(context, device, cl::CommandQueue(context, device), boardBuild.get(),
+                                  actorBuild.get());
+            // Work-group sizes do not change the result, the defaults save tuning every device.
+            simulation.setDeterministic(true);
+            if (settings.seek)
+                KeyframeStore(context, settings.keyframes, settings.keyframeInterval, 0).seek(simulation,
+                                                                                             *settings.seek);
+            else if (checkpoint)
+                checkpoint->restore(simulation);
+            else
+                simulation.reset(boardSize, members, seed, SpawnRegion::centered(settings.spawn, boardSize));
+            for (int remaining = settings.checksumGenerations; remaining > 0; remaining -= generationsPerReplay)
+                simulation.step(std::min(remaining, generationsPerReplay));
+            std::cout << fmt::format("{:016x} after generation {} on {}", simulation.checksum(),
+                                     simulation.generation(), name) << std::endl;
+        }
+        catch (const cl::Error &error)
+        {
+            std::cerr << fmt::format("{}: {}({})", name, error.what(), error.err()) << std::endl;
+            ++failed;
+        }
+        catch (const Exception &e)
+        {
+            std::cerr << fmt::format("{}: {}", name, e.what()) << std::endl;
+            ++failed;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Settings.h"
+#include "assets/Parameters.h"
+
+#include <vector>
+
+class Checkpoint;
+
+// Simulates settings.checksumGenerations generations of `members` headless in deterministic mode on every OpenCL
+// device and prints the state checksum of each, starting from the keyframe seek of settings.seek or from `checkpoint`
+// if given. The same checksum on two runs, e.g. before and after changing a kernel, means the same state. Returns the
+// number of devices that failed.
+int runChecksum(const Settings &settings, const std::vector<Parameters> &members, const Checkpoint *checkpoint);
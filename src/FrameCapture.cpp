@@ -0,0 +1,275 @@
+#include "FrameCapture.h"
+
+#include "Exception.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+
+// The simulation has no notion of time, videos play at a fixed rate.
+const int framesPerSecond = 30;
+
+bool endsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::uint8_t clampByte(float value)
+{
+    return static_cast<std::uint8_t>(std::clamp(value + .5f, 0.f, 255.f));
+}
+
+}
+
+FrameCapture::FrameCapture(std::string path, int width, int height, int ringSize) :
+    m_path(std::move(path)),
+    m_width(width),
+    m_height(height),
+    m_y4m(endsWith(m_path, ".y4m")),
+    m_slots(std::max(ringSize, 2))
+{
+    if (m_y4m)
+    {
+        m_stream.open(m_path, std::ios::binary | std::ios::trunc);
+        if (!m_stream)
+            throw Exception(fmt::format("Unable to write {}", m_path));
+        // 4:2:0 needs even sizes, an odd last row or column is dropped.
+        m_stream << fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", m_width & ~1, m_height & ~1,
+                                framesPerSecond);
+    }
+
+    const GLsizeiptr size = static_cast<GLsizeiptr>(m_width) * m_height * 4;
+    for (Slot &slot : m_slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_thread = std::thread(&FrameCapture::run, this);
+    std::cout << fmt::format("Capturing {}x{} to {}", m_width, m_height, m_path) << std::endl;
+}
+
+FrameCapture::~FrameCapture()
+{
+    // Every frame already read is written, the writer keeps its queue until it is empty.
+    while (!m_inFlight.empty())
+        collect(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+
+    for (Slot &slot : m_slots)
+        glDeleteBuffers(1, &slot.buffer);
+    std::cout << fmt::format("Captured {} frames to {}, {} dropped", m_frames - m_dropped, m_path, m_dropped)
+              << std::endl;
+}
+
+void FrameCapture::capture()
+{
+    collect(false);
+
+    Slot &slot = m_slots[m_next];
+    ++m_frames;
+    if (slot.state != SlotState::Free)
+    {
+        ++m_dropped;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SlotState::Reading;
+    m_inFlight.push_back(m_next);
+    m_next = (m_next + 1) % m_slots.size();
+}
+
+void FrameCapture::collect(bool wait)
+{
+    // Filled buffers go to the writer in capture order, so this stops at the first one still being read.
+    for (const std::size_t index : m_inFlight)
+    {
+        Slot &slot = m_slots[index];
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (slot.state != SlotState::Reading)
+                continue;
+        }
+        const GLenum status = glClientWaitSync(slot.fence, 0, wait ? GLuint64(1000000000) : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        const void *pixels = nullptr;
+        if (status != GL_WAIT_FAILED)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(m_width) * m_height * 4, GL_MAP_READ_BIT);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.pixels = static_cast<const std::uint8_t *>(pixels);
+            if (!pixels)
+            {
+                // A frame that cannot be read is dropped, its slot is freed below like a written one.
+                slot.state = SlotState::Written;
+                ++m_dropped;
+                continue;
+            }
+            slot.state = SlotState::Mapped;
+            m_queue.push_back(index);
+        }
+        m_condition.notify_all();
+    }
+
+    // Buffers can only be unmapped on this thread.
+    while (!m_inFlight.empty())
+    {
+        Slot &slot = m_slots[m_inFlight.front()];
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (wait && slot.state == SlotState::Mapped)
+                m_condition.wait(lock, [&slot]() { return slot.state == SlotState::Written; });
+            if (slot.state != SlotState::Written)
+                break;
+            slot.state = SlotState::Free;
+        }
+        if (slot.pixels)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.pixels = nullptr;
+        }
+        m_inFlight.pop_front();
+    }
+}
+
+int FrameCapture::width() const
+{
+    return m_width;
+}
+
+int FrameCapture::height() const
+{
+    return m_height;
+}
+
+int FrameCapture::frames() const
+{
+    return m_frames;
+}
+
+int FrameCapture::dropped() const
+{
+    return m_dropped;
+}
+
+void FrameCapture::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_condition.wait(lock, [this]() { return !m_queue.empty() || m_stop; });
+        if (m_queue.empty())
+            return;
+        const std::size_t index = m_queue.front();
+        m_queue.pop_front();
+        const std::uint8_t *pixels = m_slots[index].pixels;
+        lock.unlock();
+
+        if (pixels)
+            write(pixels);
+
+        lock.lock();
+        m_slots[index].state = SlotState::Written;
+        m_condition.notify_all();
+    }
+}
+
+void FrameCapture::write(const std::uint8_t *pixels)
+{
+    try
+    {
+        if (m_y4m)
+            writeY4m(pixels);
+        else
+            writePpm(pixels, m_written);
+        ++m_written;
+    }
+    catch (const Exception &e)
+    {
+        if (!m_failed)
+            std::cout << e.what() << std::endl;
+        m_failed = true;
+    }
+}
+
+void FrameCapture::writeY4m(const std::uint8_t *pixels)
+{
+    // Full range BT.601 as declared by C420jpeg, chroma averaged over 2x2 pixels. OpenGL rows start at the bottom.
+    const int width = m_width & ~1;
+    const int height = m_height & ~1;
+    const std::size_t lumaSize = static_cast<std::size_t>(width) * height;
+    m_planes.resize(lumaSize + lumaSize / 2);
+    std::uint8_t *luma = m_planes.data();
+    std::uint8_t *cb = luma + lumaSize;
+    std::uint8_t *cr = cb + lumaSize / 4;
+
+    for (int y = 0; y < height; y += 2)
+        for (int x = 0; x < width; x += 2)
+        {
+            float r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; ++dy)
+                for (int dx = 0; dx < 2; ++dx)
+                {
+                    const std::uint8_t *p = pixels + (static_cast<std::size_t>(m_height - 1 - y - dy) * m_width
+                                                      + x + dx) * 4;
+                    luma[static_cast<std::size_t>(y + dy) * width + x + dx]
+                            = clampByte(.299f * p[0] + .587f * p[1] + .114f * p[2]);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            const std::size_t chroma = static_cast<std::size_t>(y / 2) * (width / 2) + x / 2;
+            cb[chroma] = clampByte(128 - .168736f * r - .331264f * g + .5f * b);
+            cr[chroma] = clampByte(128 + .5f * r - .418688f * g - .081312f * b);
+        }
+
+    m_stream << "FRAME\n";
+    m_stream.write(reinterpret_cast<const char *>(m_planes.data()), static_cast<std::streamsize>(m_planes.size()));
+    if (!m_stream)
+        throw Exception(fmt::format("Writing {} failed", m_path));
+}
+
+void FrameCapture::writePpm(const std::uint8_t *pixels, int frame)
+{
+    const std::string path = fmt::format("{}-{:06}.ppm", m_path, frame);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << fmt::format("P6\n{} {}\n255\n", m_width, m_height);
+    m_planes.resize(static_cast<std::size_t>(m_width) * 3);
+    for (int y = m_height - 1; y >= 0; --y)
+    {
+        const std::uint8_t *row = pixels + static_cast<std::size_t>(y) * m_width * 4;
+        for (int x = 0; x < m_width; ++x)
+            std::copy_n(row + x * 4, 3, m_planes.data() + x * 3);
+        out.write(reinterpret_cast<const char *>(m_planes.data()), static_cast<std::streamsize>(m_planes.size()));
+    }
+    if (!out)
+        throw Exception(fmt::format("Writing {} failed", path));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "OpenGLUtil.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the frames drawn into the window. glReadPixels goes into a ring of pixel pack buffers and a fence marks
+// when each one is filled, so the frame loop never waits for the GPU. Filled buffers are mapped and handed to a
+// writer thread as they are; the render thread only unmaps them once written.
+//
+// A path ending in .y4m is written as one YUV4MPEG2 stream (4:2:0), anything else as a numbered PPM sequence
+// <path>-000000.ppm, <path>-000001.ppm, ...
+class FrameCapture
+{
+public:
+    // Captures the bottom left width x height pixels of the framebuffer. Throws Exception if `path` can't be written.
+    FrameCapture(std::string path, int width, int height, int ringSize = 4);
+    // Writes out the frames still in flight.
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    // Captures the current read framebuffer. Call after drawing, before swapping buffers. Drops the frame if every
+    // buffer of the ring is still busy.
+    void capture();
+
+    [[nodiscard]] int width() const;
+    [[nodiscard]] int height() const;
+    [[nodiscard]] int frames() const;
+    [[nodiscard]] int dropped() const;
+
+private:
+    enum class SlotState
+    {
+        Free,
+        Reading,
+        Mapped,
+        Written
+    };
+
+    struct Slot
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        SlotState state = SlotState::Free;
+        const std::uint8_t *pixels = nullptr;
+    };
+
+    // Passes filled slots on to the writer and unmaps the written ones. With `wait` it blocks for the oldest slot.
+    void collect(bool wait);
+    void run();
+    // Writer thread only, like the members after m_stream.
+    void write(const std::uint8_t *pixels);
+    void writeY4m(const std::uint8_t *pixels);
+    void writePpm(const std::uint8_t *pixels, int frame);
+
+    const std::string m_path;
+    const int m_width;
+    const int m_height;
+    const bool m_y4m;
+    std::ofstream m_stream;
+    std::vector<std::uint8_t> m_planes;
+    int m_written = 0;
+    bool m_failed = false;
+
+    std::vector<Slot> m_slots;
+    std::size_t m_next = 0;
+    // Slots in capture order, from Reading to Written.
+    std::deque<std::size_t> m_inFlight;
+    int m_frames = 0;
+    int m_dropped = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    // Mapped slots waiting for the writer.
+    std::deque<std::size_t> m_queue;
+    bool m_stop = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,203 @@
+#include "FrameSequence.h"
+
+#include "Exception.h"
+
+#include <CL/cl_ext.h>
+#include <fmt/core.h>
+
+#include <iostream>
+
+namespace
+{
+
+// cl_khr_command_buffer entry points. Declared here instead of taken from cl_ext.h, because older headers do not
+// know the extension and the functions have to be queried at runtime anyway.
+using CommandBufferKhr = struct _cl_command_buffer_khr *;
+using MutableCommandKhr = struct _cl_mutable_command_khr *;
+using SyncPointKhr = cl_uint;
+
+using CreateCommandBufferFn = CommandBufferKhr (CL_API_CALL *)(cl_uint, const cl_command_queue *, const cl_ulong *,
+                                                               cl_int *);
+using CommandNDRangeKernelFn = cl_int (CL_API_CALL *)(CommandBufferKhr, cl_command_queue, const cl_ulong *, cl_kernel,
+                                                      cl_uint, const size_t *, const size_t *, const size_t *,
+                                                      cl_uint, const SyncPointKhr *, SyncPointKhr *,
+                                                      MutableCommandKhr *);
+using FinalizeCommandBufferFn = cl_int (CL_API_CALL *)(CommandBufferKhr);
+using EnqueueCommandBufferFn = cl_int (CL_API_CALL *)(cl_uint, cl_command_queue *, CommandBufferKhr, cl_uint,
+                                                      const cl_event *, cl_event *);
+using ReleaseCommandBufferFn = cl_int (CL_API_CALL *)(CommandBufferKhr);
+
+const std::string COMMAND_BUFFER_EXT = "cl_khr_command_buffer";
+#ifdef CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES_KHR
+const cl_uint CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES =
+        CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES_KHR;
+#else
+// 0x12A9 is CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR.
+const cl_uint CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES = 0x12AA;
+#endif
+
+template<typename T>
+T extensionFunction(cl_platform_id platform, const char *name)
+{
+    return reinterpret_cast<T>(clGetExtensionFunctionAddressForPlatform(platform, name));
+}
+
+}
+
+struct FrameSequence::CommandBuffer
+{
+    CreateCommandBufferFn create = nullptr;
+    CommandNDRangeKernelFn ndRangeKernel = nullptr;
+    FinalizeCommandBufferFn finalize = nullptr;
+    EnqueueCommandBufferFn enqueue = nullptr;
+    ReleaseCommandBufferFn release = nullptr;
+
+    CommandBufferKhr handle = nullptr;
+
+    [[nodiscard]] bool valid() const
+    {
+        return create && ndRangeKernel && finalize && enqueue && release;
+    }
+
+    void reset()
+    {
+        if (handle)
+            release(handle);
+        handle = nullptr;
+    }
+};
+
+FrameSequence::FrameSequence(const cl::Device &device, const cl::CommandQueue &queue, bool allowCommandBuffer) :
+    m_queue(queue)
+{
+    if (!allowCommandBuffer || !checkExtnAvailability(device, COMMAND_BUFFER_EXT))
+        return;
+
+    // Some implementations can only record into queues with particular properties (e.g. profiling).
+    cl_command_queue_properties required = 0;
+    if (clGetDeviceInfo(device(), CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES, sizeof(required), &required,
+                        nullptr) == CL_SUCCESS
+            && (required & ~queue.getInfo<CL_QUEUE_PROPERTIES>()) != 0)
+        return;
+
+    const cl_platform_id platform = device.getInfo<CL_DEVICE_PLATFORM>();
+    auto commandBuffer = std::make_unique<CommandBuffer>();
+    commandBuffer->create = extensionFunction<CreateCommandBufferFn>(platform, "clCreateCommandBufferKHR");
+    commandBuffer->ndRangeKernel = extensionFunction<CommandNDRangeKernelFn>(platform, "clCommandNDRangeKernelKHR");
+    commandBuffer->finalize = extensionFunction<FinalizeCommandBufferFn>(platform, "clFinalizeCommandBufferKHR");
+    commandBuffer->enqueue = extensionFunction<EnqueueCommandBufferFn>(platform, "clEnqueueCommandBufferKHR");
+    commandBuffer->release = extensionFunction<ReleaseCommandBufferFn>(platform, "clReleaseCommandBufferKHR");
+    if (commandBuffer->valid())
+        m_commandBuffer = std::move(commandBuffer);
+}
+
+FrameSequence::~FrameSequence()
+{
+    clear();
+}
+
+void FrameSequence::record(const std::vector<Launch> &step, int repetitions)
+{
+    clear();
+    for (int i = 0; i < repetitions; ++i)
+        m_launches.insert(m_launches.end(), step.begin(), step.end());
+    m_repetitions = repetitions;
+
+    if (!m_commandBuffer)
+        return;
+
+    cl_command_queue queue = m_queue();
+    cl_int errCode = CL_SUCCESS;
+    m_commandBuffer->handle = m_commandBuffer->create(1, &queue, nullptr, &errCode);
+    if (errCode != CL_SUCCESS)
+    {
+        // Recording is an optimization only, keep the host list.
+        std::cout << fmt::format("clCreateCommandBufferKHR failed ({}), using host enqueue list", errCode) << std::endl;
+        m_commandBuffer.reset();
+        return;
+    }
+
+    // Commands in a command buffer are unordered unless chained by sync points.
+    SyncPointKhr previous = 0;
+    for (std::size_t i = 0; i < m_launches.size(); ++i)
+    {
+        const Launch &launch = m_launches[i];
+        SyncPointKhr current = 0;
+        errCode = m_commandBuffer->ndRangeKernel(m_commandBuffer->handle, nullptr, nullptr, launch.kernel(),
+                                                 launch.global.dimensions(),
+                                                 launch.offset.dimensions() ? launch.offset.get() : nullptr,
+                                                 launch.global.get(),
+                                                 launch.local.dimensions() ? launch.local.get() : nullptr,
+                                                 i ? 1 : 0, i ? &previous : nullptr, &current, nullptr);
+        if (errCode != CL_SUCCESS)
+            break;
+        previous = current;
+    }
+    if (errCode == CL_SUCCESS)
+        errCode = m_commandBuffer->finalize(m_commandBuffer->handle);
+    if (errCode != CL_SUCCESS)
+    {
+        std::cout << fmt::format("Recording command buffer failed ({}), using host enqueue list", errCode) << std::endl;
+        m_commandBuffer->reset();
+        m_commandBuffer.reset();
+    }
+}
+
+void FrameSequence::replay(const std::vector<cl::Event> *waitFor, cl::Event *done,
+                           std::vector<cl::Event> *launches) const
+{
+    if (m_commandBuffer && m_commandBuffer->handle && !launches)
+    {
+        std::vector<cl_event> events;
+        if (waitFor)
+            for (const cl::Event &e : *waitFor)
+                events.push_back(e());
+        cl_command_queue queue = m_queue();
+        cl_event event = nullptr;
+        const cl_int errCode = m_commandBuffer->enqueue(1, &queue, m_commandBuffer->handle,
+                                                        static_cast<cl_uint>(events.size()),
+                                                        events.empty() ? nullptr : events.data(),
+                                                        done ? &event : nullptr);
+        if (errCode != CL_SUCCESS)
+            throw Exception(fmt::format("Failed enqueueing command buffer: {}", errCode));
+        if (done)
+            *done = cl::Event(event);
+        return;
+    }
+
+    for (std::size_t i = 0; i < m_launches.size(); ++i)
+    {
+        const Launch &launch = m_launches[i];
+        const bool last = i + 1 == m_launches.size();
+        cl::Event event;
+        m_queue.enqueueNDRangeKernel(launch.kernel, launch.offset, launch.global, launch.local,
+                                     i == 0 ? waitFor : nullptr, (last && done) || launches ? &event : nullptr);
+        if (launches)
+            launches->push_back(event);
+        if (last && done)
+            *done = event;
+    }
+}
+
+void FrameSequence::clear()
+{
+    if (m_commandBuffer)
+        m_commandBuffer->reset();
+    m_launches.clear();
+    m_repetitions = 0;
+}
+
+bool FrameSequence::recorded() const
+{
+    return m_repetitions > 0;
+}
+
+int FrameSequence::repetitions() const
+{
+    return m_repetitions;
+}
+
+bool FrameSequence::usesCommandBuffer() const
+{
+    return m_commandBuffer && m_commandBuffer->handle;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+
+#include <memory>
+#include <vector>
+
+// Records the kernel launches of one frame once and replays them every frame. Uses cl_khr_command_buffer when the
+// device supports it, otherwise keeps a host side list of launches whose arguments are all set in advance.
+class FrameSequence
+{
+public:
+    struct Launch
+    {
+        cl::Kernel kernel;
+        cl::NDRange global;
+        cl::NDRange local;
+        // Of the global ids, e.g. for one chunk of a launch split into several.
+        cl::NDRange offset = cl::NullRange;
+    };
+
+    FrameSequence(const cl::Device &device, const cl::CommandQueue &queue, bool allowCommandBuffer = true);
+    ~FrameSequence();
+
+    FrameSequence(const FrameSequence &) = delete;
+    FrameSequence &operator=(const FrameSequence &) = delete;
+
+    // Records the launches of one step, repeated `repetitions` times. Kernel arguments are captured now, so they
+    // must not change until the next call to record().
+    void record(const std::vector<Launch> &step, int repetitions);
+    // With `launches`, every launch is enqueued on its own and its event appended there, e.g. for profiling; the
+    // command buffer only has one event for all of them.
+    void replay(const std::vector<cl::Event> *waitFor = nullptr, cl::Event *done = nullptr,
+                std::vector<cl::Event> *launches = nullptr) const;
+    void clear();
+
+    [[nodiscard]] bool recorded() const;
+    [[nodiscard]] int repetitions() const;
+    [[nodiscard]] bool usesCommandBuffer() const;
+
+private:
+    struct CommandBuffer;
+
+    cl::CommandQueue m_queue;
+    std::unique_ptr<CommandBuffer> m_commandBuffer;
+    std::vector<Launch> m_launches;
+    int m_repetitions = 0;
+};
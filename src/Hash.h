@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a. Not cryptographic, only used to tell contents apart.
+class Hash
+{
+public:
+    Hash &add(const void *data, std::size_t size)
+    {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            m_value ^= bytes[i];
+            m_value *= 0x100000001b3ull;
+        }
+        return *this;
+    }
+
+    Hash &add(const std::string &text)
+    {
+        // Includes the length, so that ("ab", "c") and ("a", "bc") differ.
+        const std::uint64_t size = text.size();
+        add(&size, sizeof(size));
+        return add(text.data(), text.size());
+    }
+
+    [[nodiscard]] std::uint64_t value() const
+    {
+        return m_value;
+    }
+
+private:
+    std::uint64_t m_value = 0xcbf29ce484222325ull;
+};
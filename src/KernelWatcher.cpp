@@ -0,0 +1,105 @@
+#include "KernelWatcher.h"
+
+#include "Exception.h"
+#include "ProgramBuilder.h"
+#include "ProgramSource.h"
+
+#include <fmt/core.h>
+
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+const std::chrono::milliseconds SCAN_INTERVAL(250);
+
+}
+
+KernelWatcher::KernelWatcher(const cl::Context &context, const cl::Device &device, const ProgramCache &cache,
+                             std::string directory) :
+    m_context(context),
+    m_device(device),
+    m_cache(cache),
+    m_directory(std::move(directory))
+{
+    m_timestamps = scan();
+    m_nextScan = std::chrono::steady_clock::now() + SCAN_INTERVAL;
+    std::cout << fmt::format("Watching {} for kernel changes", m_directory) << std::endl;
+}
+
+std::optional<KernelWatcher::Programs> KernelWatcher::poll()
+{
+    if (m_build.valid() && m_build.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        try
+        {
+            Programs programs = m_build.get();
+            std::cout << "Kernels reloaded" << std::endl;
+            return programs;
+        }
+        catch (const Exception &e)
+        {
+            std::cout << "Kernel reload failed, keeping the running kernels\n" << e.what() << std::endl;
+        }
+        catch (const cl::Error &error)
+        {
+            std::cout << fmt::format("Kernel reload failed, keeping the running kernels: {}({})", error.what(),
+                                     error.err()) << std::endl;
+        }
+        return std::nullopt;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now < m_nextScan)
+        return std::nullopt;
+    m_nextScan = now + SCAN_INTERVAL;
+
+    Timestamps timestamps = scan();
+    if (timestamps != m_timestamps)
+    {
+        m_timestamps = std::move(timestamps);
+        m_changed = true;
+    }
+    else if (m_changed && !m_build.valid())
+    {
+        m_changed = false;
+        startBuild();
+    }
+    return std::nullopt;
+}
+
+KernelWatcher::Timestamps KernelWatcher::scan() const
+{
+    Timestamps timestamps;
+    std::error_code error;
+    for (const fs::directory_entry &entry : fs::directory_iterator(m_directory, error))
+    {
+        const fs::path &path = entry.path();
+        // Headers included by the programs count as well.
+        if (path.extension() != ".cl" && path.extension() != ".h")
+            continue;
+        const fs::file_time_type time = fs::last_write_time(path, error);
+        if (!error)
+            timestamps[path.filename().string()] = time;
+    }
+    return timestamps;
+}
+
+void KernelWatcher::startBuild()
+{
+    std::cout << "Kernel sources changed, rebuilding" << std::endl;
+    m_build = std::async(std::launch::async, [this]()
+    {
+        const std::string directory = m_directory;
+        ProgramBuilder builder(m_context, m_device, m_cache, "", [directory](const std::string &name)
+        {
+            return loadProgramSource(directory, name);
+        });
+        const std::shared_future<cl::Program> board = builder.build(loadProgramSource(directory, "Board.cl"));
+        const std::shared_future<cl::Program> actor = builder.build(loadProgramSource(directory, "Actor.cl"));
+        return Programs{board.get(), actor.get()};
+    });
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <optional>
+#include <string>
+
+// Watches the device program sources in a directory and rebuilds the board and actor programs in the background
+// when one of them changes. Polled once per frame; a failed build is reported and leaves the running kernels alone.
+class KernelWatcher
+{
+public:
+    struct Programs
+    {
+        cl::Program board;
+        cl::Program actor;
+    };
+
+    // `cache` has to outlive the watcher.
+    KernelWatcher(const cl::Context &context, const cl::Device &device, const ProgramCache &cache,
+                  std::string directory);
+
+    // Returns the programs once after each successful rebuild. Never blocks.
+    [[nodiscard]] std::optional<Programs> poll();
+
+private:
+    using Timestamps = std::map<std::string, std::filesystem::file_time_type>;
+
+    [[nodiscard]] Timestamps scan() const;
+    void startBuild();
+
+    cl::Context m_context;
+    cl::Device m_device;
+    const ProgramCache &m_cache;
+    std::string m_directory;
+
+    Timestamps m_timestamps;
+    std::chrono::steady_clock::time_point m_nextScan;
+    // Sources changed and the next scan has to see them settled, editors often save in several steps.
+    bool m_changed = false;
+    std::future<Programs> m_build;
+};
@@ -0,0 +1,143 @@
+#include "KeyframeStore.h"
+
+#include "Exception.h"
+#include "Simulation.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+const std::string keyframePrefix = "keyframe-";
+const std::string keyframeExtension = ".checkpoint";
+
+// Generations recorded into one frame sequence while seeking, and replays between waits so the queue stays short.
+const int generationsPerReplay = 100;
+const int replaysPerFinish = 50;
+
+}
+
+KeyframeStore::KeyframeStore(const cl::Context &context, std::string directory, int interval,
+                             std::uintmax_t budget) :
+    m_directory(std::move(directory)),
+    m_interval(interval),
+    m_budget(budget),
+    m_writer(context, false)
+{
+    std::error_code error;
+    fs::create_directories(m_directory, error);
+    if (error)
+        throw Exception(fmt::format("Unable to create keyframe directory {}: {}", m_directory, error.message()));
+    for (const fs::directory_entry &entry : fs::directory_iterator(m_directory, error))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(keyframePrefix, 0) != 0 || entry.path().extension() != keyframeExtension)
+            continue;
+        const std::string number = name.substr(keyframePrefix.size(),
+                                               name.size() - keyframePrefix.size() - keyframeExtension.size());
+        const bool numeric = !number.empty() && std::all_of(number.begin(), number.end(), [](unsigned char c)
+        {
+            return std::isdigit(c);
+        });
+        if (numeric)
+            m_keyframes[std::stoi(number)] = entry.path().string();
+    }
+}
+
+void KeyframeStore::discardFrom(int generation)
+{
+    for (auto it = m_keyframes.lower_bound(generation); it != m_keyframes.end(); it = m_keyframes.erase(it))
+    {
+        std::error_code error;
+        fs::remove(it->second, error);
+    }
+}
+
+void KeyframeStore::record(const Simulation &simulation)
+{
+    // Due unless there is a keyframe within the last interval, which also covers runs continued from a keyframe.
+    const int generation = simulation.generation();
+    const auto previous = m_keyframes.upper_bound(generation);
+    if (previous != m_keyframes.begin() && std::prev(previous)->first > generation - m_interval)
+        return;
+    if (!m_writer.save(simulation, path(generation)))
+        return;
+    m_keyframes[generation] = path(generation);
+    enforceBudget();
+}
+
+void KeyframeStore::seek(Simulation &simulation, int generation) const
+{
+    // The newest keyframe may still be being written.
+    auto it = m_keyframes.upper_bound(generation);
+    while (it != m_keyframes.begin() && !fs::exists(std::prev(it)->second))
+        --it;
+    if (it == m_keyframes.begin())
+        throw Exception(fmt::format("No keyframe at or before generation {} in {}", generation, m_directory));
+
+    const auto &[start, file] = *std::prev(it);
+    Checkpoint(file).restore(simulation);
+    for (int replays = 1; simulation.generation() < generation; ++replays)
+    {
+        simulation.step(std::min(generation - simulation.generation(), generationsPerReplay));
+        if (replays % replaysPerFinish == 0)
+            simulation.queue().finish();
+    }
+    simulation.queue().finish();
+    std::cout << fmt::format("Seeked to generation {} from the keyframe of generation {}", generation, start)
+              << std::endl;
+}
+
+void KeyframeStore::wait()
+{
+    m_writer.wait();
+}
+
+std::string KeyframeStore::path(int generation) const
+{
+    return (fs::path(m_directory) / fmt::format("{}{}{}", keyframePrefix, generation, keyframeExtension)).string();
+}
+
+void KeyframeStore::enforceBudget()
+{
+    const auto used = [this]()
+    {
+        std::uintmax_t total = 0;
+        for (const auto &keyframe : m_keyframes)
+        {
+            // The keyframe being written does not count yet.
+            std::error_code error;
+            const std::uintmax_t size = fs::file_size(keyframe.second, error);
+            total += error ? 0 : size;
+        }
+        return total;
+    };
+    while (m_keyframes.size() > 2 && used() > m_budget)
+    {
+        // Every other keyframe but the first and the newest, which may still be being written.
+        bool drop = false;
+        for (auto it = std::next(m_keyframes.begin()); std::next(it) != m_keyframes.end();)
+        {
+            drop = !drop;
+            if (!drop)
+            {
+                ++it;
+                continue;
+            }
+            std::error_code error;
+            fs::remove(it->second, error);
+            it = m_keyframes.erase(it);
+        }
+        m_interval *= 2;
+        std::cout << fmt::format("Keyframes exceed {} MiB, now every {} generations", m_budget >> 20, m_interval)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Checkpoint.h"
+#include "OpenCLUtil.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+class Simulation;
+
+// Keyframes of a deterministic run, so any generation can be reached by restoring the nearest earlier keyframe and
+// simulating forward instead of starting over. Keyframes are checkpoints, keyframe-<generation>.checkpoint in one
+// directory, written in the background by a CheckpointWriter, which holds the only copy in memory. When the files
+// exceed the disk budget every other keyframe is dropped and the interval doubles, so a run of any length keeps
+// keyframes spread over all of it.
+class KeyframeStore
+{
+public:
+    // Picks up the keyframes already in `directory`, creating it if needed. Throws Exception if that fails.
+    KeyframeStore(const cl::Context &context, std::string directory, int interval, std::uintmax_t budget);
+
+    // Drops the keyframes from `generation` on, e.g. those of an earlier run when starting a new one.
+    void discardFrom(int generation);
+
+    // Saves a keyframe of `simulation` if one is due, as of the commands enqueued so far. Call after every step;
+    // while the previous keyframe is still being written the next one waits.
+    void record(const Simulation &simulation);
+
+    // Brings `simulation` to `generation`: restores the newest keyframe at or before it and steps the remaining
+    // generations. `simulation` has to be deterministic for the result to match the original run. Throws Exception
+    // if there is no such keyframe.
+    void seek(Simulation &simulation, int generation) const;
+
+    // Blocks until the last keyframe is on disk.
+    void wait();
+
+private:
+    [[nodiscard]] std::string path(int generation) const;
+    void enforceBudget();
+
+    std::string m_directory;
+    int m_interval;
+    std::uintmax_t m_budget;
+    // Generation to file, including the one being written.
+    std::map<int, std::string> m_keyframes;
+    CheckpointWriter m_writer;
+};
@@ -0,0 +1,257 @@
+#include "LaunchTuner.h"
+
+#include "Exception.h"
+#include "Hash.h"
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Generations before and while timing a candidate.
+const int warmupGenerations = 2;
+const int timedGenerations = 8;
+
+// Tuners of different devices may save at the same time, e.g. in sweeps. Each merges the file into its results
+// before writing it, so saves in this process take turns.
+std::mutex saveMutex;
+
+std::string deviceKey(const cl::Device &device)
+{
+    Hash hash;
+    hash.add(device.getInfo<CL_DEVICE_NAME>());
+    hash.add(device.getInfo<CL_DEVICE_VERSION>());
+    hash.add(device.getInfo<CL_DRIVER_VERSION>());
+    return fmt::format("{:016x}", hash.value());
+}
+
+// Largest work-group every kernel launched with LaunchShape::boardLocal takes, see Simulation::step(). Only board()
+// is timed, the deterministic mode launches diffuse() and commitTrail() with the same size instead.
+int boardMaximum(const cl::Program &boardProgram, const cl::Device &device)
+{
+    int maximum = std::numeric_limits<int>::max();
+    for (const char *name : {"board", "diffuse", "commitTrail"})
+    {
+        const cl::Kernel kernel(boardProgram, name);
+        maximum = std::min(maximum, static_cast<int>(kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device)));
+    }
+    return maximum;
+}
+
+int bucket(double count)
+{
+    return count < 1 ? 0 : static_cast<int>(std::lround(std::log2(count)));
+}
+
+// Median time of one launch of `kernel` ("actor" or "board") with `shape`, infinity if the device refuses it.
+double measure(Simulation &simulation, Profiler &profiler, const LaunchShape &shape, const std::string &kernel)
+{
+    double seconds = std::numeric_limits<double>::infinity();
+    try
+    {
+        simulation.setLaunchShape(shape);
+        simulation.step(warmupGenerations);
+        simulation.queue().finish();
+        profiler.poll(true);
+        profiler.reset();
+        simulation.step(timedGenerations);
+        profiler.poll(true);
+        const Profiler::Summary summary = profiler.summary(kernel);
+        if (summary.launches > 0)
+            seconds = summary.p50;
+    }
+    catch (const cl::Error &)
+    {
+        // CL_INVALID_WORK_GROUP_SIZE, CL_OUT_OF_RESOURCES and the like rule the candidate out
+        simulation.queue().finish();
+    }
+    profiler.poll(true);
+    profiler.reset();
+    return seconds;
+}
+
+}
+
+LaunchTuner::LaunchTuner(const std::string &cacheDirectory) :
+    m_path(cacheDirectory.empty() ? "" : (fs::path(cacheDirectory) / "launch-shapes.txt").string())
+{
+    load();
+}
+
+LaunchShape LaunchTuner::tune(const cl::Context &context, const cl::Device &device, const cl::Program &boardProgram,
+                              const cl::Program &actorProgram, int2 boardSize, const std::vector<Parameters> &members,
+                              bool retune)
+{
+    int actorCount = 0;
+    for (const Parameters &p : members)
+        actorCount = std::max(actorCount, p.actorCount);
+    const std::string deviceHash = deviceKey(device);
+    const std::string actorKey = fmt::format("{} actor {}", deviceHash, bucket(actorCount));
+    const std::string boardKey = fmt::format("{} board {}", deviceHash, bucket(double(boardSize.x) * boardSize.y));
+
+    int boardLimit = std::numeric_limits<int>::max();
+    try
+    {
+        boardLimit = boardMaximum(boardProgram, device);
+    }
+    catch (const cl::Error &)
+    {
+        // Left to the tuning below, which reports it.
+    }
+
+    LaunchShape shape;
+    const auto actorResult = m_results.find(actorKey);
+    const auto boardResult = m_results.find(boardKey);
+    // Results of older builds may exceed what the kernels take now.
+    if (!retune && actorResult != m_results.end() && boardResult != m_results.end()
+            && boardResult->second.x * boardResult->second.y <= boardLimit)
+    {
+        shape.actorLocal = actorResult->second.x;
+        shape.boardLocal = boardResult->second;
+        return shape;
+    }
+
+    const std::string name = device.getInfo<CL_DEVICE_NAME>();
+    std::cout << fmt::format("Tuning work-group sizes for {}", name) << std::endl;
+    try
+    {
+        Profiler profiler;
+        Simulation simulation(context, device, cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE),
+                              boardProgram, actorProgram);
+        simulation.setProfiler(&profiler);
+        // The most demanding member stands in for all of them.
+        const auto busiest = std::max_element(members.begin(), members.end(),
+                                              [](const Parameters &a, const Parameters &b)
+                                              { return a.actorCount < b.actorCount; });
+        simulation.reset(boardSize, {*busiest}, 1, SpawnRegion::centered(SPAWN_DISC, boardSize));
+
+        double best = std::numeric_limits<double>::infinity();
+        LaunchShape candidate = shape;
+        for (const int local : actorCandidates(cl::Kernel(actorProgram, "actor"), device))
+        {
+            candidate.actorLocal = local;
+            const double seconds = measure(simulation, profiler, candidate, "actor");
+            if (seconds < best)
+            {
+                best = seconds;
+                shape.actorLocal = local;
+            }
+        }
+
+        best = std::numeric_limits<double>::infinity();
+        candidate = shape;
+        for (const int2 local : boardCandidates(cl::Kernel(boardProgram, "board"), device,
+                                                boardMaximum(boardProgram, device)))
+        {
+            candidate.boardLocal = local;
+            const double seconds = measure(simulation, profiler, candidate, "board");
+            if (seconds < best)
+            {
+                best = seconds;
+                shape.boardLocal = local;
+            }
+        }
+    }
+    catch (const cl::Error &error)
+    {
+        std::cout << fmt::format("Tuning failed: {}({}), using default work-group sizes", error.what(), error.err())
+                  << std::endl;
+        return LaunchShape();
+    }
+    catch (const Exception &e)
+    {
+        std::cout << fmt::format("Tuning failed: {}, using default work-group sizes", e.what()) << std::endl;
+        return LaunchShape();
+    }
+
+    std::cout << fmt::format("{}: actor {}, board {}x{}", name, shape.actorLocal, shape.boardLocal.x,
+                             shape.boardLocal.y) << std::endl;
+    m_results[actorKey] = {shape.actorLocal, 1};
+    m_results[boardKey] = shape.boardLocal;
+    save();
+    return shape;
+}
+
+std::vector<int> LaunchTuner::actorCandidates(const cl::Kernel &kernel, const cl::Device &device)
+{
+    const int maximum = static_cast<int>(kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    const int multiple = std::max<int>(
+            kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device), 1);
+    std::vector<int> candidates;
+    for (int local = multiple; local <= maximum; local *= 2)
+        candidates.push_back(local);
+    if (candidates.empty())
+        candidates.push_back(1);
+    return candidates;
+}
+
+std::vector<int2> LaunchTuner::boardCandidates(const cl::Kernel &kernel, const cl::Device &device, int maximum)
+{
+    const int multiple = std::max<int>(
+            kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device), 1);
+    std::vector<int2> candidates;
+    for (int x = 1; x <= maximum; x *= 2)
+        for (int y = 1; x * y <= maximum; y *= 2)
+            // Rows of at least 4 keep neighbouring work-items on neighbouring cells.
+            if (x >= 4 && (x * y) % multiple == 0)
+                candidates.push_back({x, y});
+    if (candidates.empty())
+        candidates.push_back({1, 1});
+    return candidates;
+}
+
+void LaunchTuner::load()
+{
+    if (m_path.empty())
+        return;
+    std::ifstream in(m_path);
+    for (std::string line; std::getline(in, line);)
+    {
+        std::istringstream fields(line);
+        std::string device, kernel;
+        int bucket = 0;
+        int2 local{0, 0};
+        if (fields >> device >> kernel >> bucket >> local.x >> local.y && local.x > 0 && local.y > 0)
+            m_results.emplace(fmt::format("{} {} {}", device, kernel, bucket), local);
+    }
+}
+
+void LaunchTuner::save()
+{
+    if (m_path.empty())
+        return;
+    std::lock_guard<std::mutex> lock(saveMutex);
+    load();
+    std::error_code error;
+    fs::create_directories(fs::path(m_path).parent_path(), error);
+    // Written next to the final name and renamed, so that concurrent runs never read half a file.
+    const std::string temporary = fmt::format("{}.{:08x}.tmp", m_path, std::random_device()());
+    {
+        std::ofstream out(temporary);
+        for (const auto &[key, local] : m_results)
+            out << key << ' ' << local.x << ' ' << local.y << '\n';
+        if (!out)
+        {
+            std::cout << fmt::format("Unable to write {}", temporary) << std::endl;
+            out.close();
+            fs::remove(temporary, error);
+            return;
+        }
+    }
+    fs::rename(temporary, m_path, error);
+    if (error)
+        std::cout << fmt::format("Unable to write {}: {}", m_path, error.message()) << std::endl;
+}
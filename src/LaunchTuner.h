@@ -0,0 +1,44 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "ProgramCache.h"
+#include "Simulation.h"
+#include "assets/Parameters.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Picks the work-group sizes of the actor and board kernels by timing candidates with profiling events, within the
+// kernel's work-group limit and in multiples of its preferred size. Results are kept per device, kernel and size
+// bucket (the power of two of the actor or cell count) in launch-shapes.txt in the cache directory, so later runs skip
+// the tuning.
+class LaunchTuner
+{
+public:
+    // An empty directory keeps the results for this run only.
+    explicit LaunchTuner(const std::string &cacheDirectory = ProgramCache::defaultDirectory());
+
+    // Work-group sizes for simulating `members` on boards of `boardSize` with the given programs. Cached results
+    // are used unless `retune`; missing ones are measured on a separate one member simulation, so this needs memory
+    // for a second board. Falls back to LaunchShape() for whatever cannot be measured.
+    [[nodiscard]] LaunchShape tune(const cl::Context &context, const cl::Device &device,
+                                   const cl::Program &boardProgram, const cl::Program &actorProgram, int2 boardSize,
+                                   const std::vector<Parameters> &members, bool retune = false);
+
+private:
+    [[nodiscard]] static std::vector<int> actorCandidates(const cl::Kernel &kernel, const cl::Device &device);
+    // Shapes of at most `maximum` work-items, preferring multiples of what `kernel` prefers.
+    [[nodiscard]] static std::vector<int2> boardCandidates(const cl::Kernel &kernel, const cl::Device &device,
+                                                           int maximum);
+
+    // Adds the results in the file to m_results, keeping those already there.
+    void load();
+    // Merges with the file first, other processes or devices may have tuned in the meantime.
+    void save();
+
+    std::string m_path;
+    // "<device hash> <kernel> <bucket>" to the best local size, y is 1 for the actor kernel.
+    std::map<std::string, int2> m_results;
+};
@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include "Exception.h"
+
+#include <fmt/core.h>
+
+#ifdef OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef OS_WIN
+
+MappedFile::MappedFile(const std::string &path) :
+    m_path(path)
+{
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_file = nullptr;
+        throw Exception(fmt::format("Unable to open {}", path));
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        CloseHandle(m_file);
+        throw Exception(fmt::format("Unable to get the size of {}", path));
+    }
+    m_size = static_cast<std::size_t>(size.QuadPart);
+    if (m_size == 0)
+        return;
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!m_data)
+    {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw Exception(fmt::format("Unable to map {}", path));
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) :
+    m_path(path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw Exception(fmt::format("Unable to open {}", path));
+    struct stat status{};
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw Exception(fmt::format("Unable to get the size of {}", path));
+    }
+    m_size = static_cast<std::size_t>(status.st_size);
+    if (m_size > 0)
+    {
+        m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_data == MAP_FAILED)
+        {
+            m_data = nullptr;
+            close(fd);
+            throw Exception(fmt::format("Unable to map {}", path));
+        }
+    }
+    // The mapping stays valid without the descriptor.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        munmap(m_data, m_size);
+}
+
+#endif
+
+const unsigned char *MappedFile::data() const
+{
+    return static_cast<const unsigned char *>(m_data);
+}
+
+std::size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+const std::string &MappedFile::path() const
+{
+    return m_path;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read only memory mapping of a whole file. Pages are loaded on first access, so only what is read costs I/O.
+class MappedFile
+{
+public:
+    // Throws Exception if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] const unsigned char *data() const;
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] const std::string &path() const;
+
+private:
+    std::string m_path;
+    void *m_data = nullptr;
+    std::size_t m_size = 0;
+#ifdef OS_WIN
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+};
@@ -1,5 +1,9 @@
 #include "OpenCLUtil.h"
 
+#include "Exception.h"
+
+#include <fmt/core.h>
+
 #include <vector>
 #include <cstdlib>
 #include <iostream>
@@ -80,7 +84,7 @@ bool checkExtnAvailability(Device pDevice, std::string pName)
             //std::cout<<"Found CL_GL_SHARING extension: "<<item<<std::endl;
             ret_val = true;
         } else {
-            std::cout<<"CL_GL_SHARING extension not found\n";
+            std::cout<<pName<<" extension not found\n";
             ret_val = false;
         }
     } catch (Error err) {
@@ -106,3 +110,27 @@ Program getProgram(Context pContext, std::string file, cl_int &error)
     }
     return ret_val;
 }
+
+Program buildProgram(Context pContext, Device pDevice, std::string name, const std::string &source,
+                     std::string options)
+{
+    Program program;
+    try
+    {
+        program = Program(pContext, Program::Sources(1, source));
+    }
+    catch(Error error)
+    {
+        throw Exception(fmt::format("Failed to create program {}: {}({})", name, error.what(), error.err()));
+    }
+    try
+    {
+        program.build(std::vector<Device>(1, pDevice), options.c_str());
+    }
+    catch(Error error)
+    {
+        throw Exception(fmt::format("Building {} failed: {}({})\nLog:\n{}", name, error.what(), error.err(),
+                                    program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(pDevice)));
+    }
+    return program;
+}
@@ -34,4 +34,9 @@ bool checkExtnAvailability(cl::Device pDevice, std::string pName);
 
 cl::Program getProgram(cl::Context pContext, std::string file, cl_int &error);
 
+// Builds the program `source` for `pDevice`. `name` only appears in error messages. Throws Exception with the build
+// log on failure.
+cl::Program buildProgram(cl::Context pContext, cl::Device pDevice, std::string name, const std::string &source,
+                         std::string options);
+
 #endif//__OPENCL_UTIL_H__
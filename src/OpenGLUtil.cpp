@@ -56,25 +56,15 @@ void printLinkInfoLog(GLint prog)
     }
 }
 
-shaders_t loadShaders(const char * vert_path, const char * frag_path) {
+shaders_t compileShaders(const char *vert_source, GLint vert_length, const char *frag_source, GLint frag_length)
+{
     GLuint f, v;
 
-    char *vs,*fs;
-
     v = glCreateShader(GL_VERTEX_SHADER);
     f = glCreateShader(GL_FRAGMENT_SHADER);
 
-    // load shaders & get length of each
-    GLint vlen;
-    GLint flen;
-    vs = loadFile(vert_path,vlen);
-    fs = loadFile(frag_path,flen);
-
-    const char * vv = vs;
-    const char * ff = fs;
-
-    glShaderSource(v, 1, &vv,&vlen);
-    glShaderSource(f, 1, &ff,&flen);
+    glShaderSource(v, 1, &vert_source, &vert_length);
+    glShaderSource(f, 1, &frag_source, &frag_length);
 
     GLint compiled;
 
@@ -95,6 +85,19 @@ shaders_t loadShaders(const char * vert_path, const char * frag_path) {
     printShaderInfoLog(f);
 
     shaders_t out; out.vertex = v; out.fragment = f;
+    return out;
+}
+
+shaders_t loadShaders(const char * vert_path, const char * frag_path) {
+    char *vs,*fs;
+
+    // load shaders & get length of each
+    GLint vlen;
+    GLint flen;
+    vs = loadFile(vert_path,vlen);
+    fs = loadFile(frag_path,flen);
+
+    shaders_t out = compileShaders(vs, vlen, fs, flen);
 
     delete [] vs; // dont forget to free allocated memory
     delete [] fs; // we allocated this in the loadFile function...
@@ -124,6 +127,15 @@ GLuint initShaders(const char* vshaderpath, const char* fshaderpath)
     return shader_program;
 }
 
+GLuint initShaderSources(const char* vshadersource, const char* fshadersource)
+{
+    // A negative length means null terminated.
+    shaders_t shaders = compileShaders(vshadersource, -1, fshadersource, -1);
+    GLuint shader_program = glCreateProgram();
+    attachAndLinkProgram(shader_program, shaders);
+    return shader_program;
+}
+
 GLuint createTexture2D(int width, int height, void* data)
 {
     GLuint ret_val = 0;
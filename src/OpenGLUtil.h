@@ -18,12 +18,16 @@ void printShaderInfoLog(GLint shader);
 
 void printLinkInfoLog(GLint prog);
 
+shaders_t compileShaders(const char *vert_source, GLint vert_length, const char *frag_source, GLint frag_length);
+
 shaders_t loadShaders(const char * vert_path, const char * frag_path);
 
 void attachAndLinkProgram( GLuint program, shaders_t shaders);
 
 GLuint initShaders(const char* vshaderpath, const char* fshaderpath);
 
+GLuint initShaderSources(const char* vshadersource, const char* fshadersource);
+
 GLuint createTexture2D(int width, int height, void* data = nullptr);
 
 GLuint createBuffer(int size, const float* data, GLenum usage);
@@ -0,0 +1,197 @@
+#include "ParameterTable.h"
+
+#include "Exception.h"
+
+#include <fmt/core.h>
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+
+template<typename T>
+T parseValue(const std::string &name, const std::string &value)
+{
+    std::istringstream in(value);
+    T result{};
+    in >> result;
+    if (in.fail() || !in.eof())
+        throw Exception(fmt::format("Invalid value '{}' for parameter {}", value, name));
+    return result;
+}
+
+}
+
+Parameters defaultParameters()
+{
+    Parameters p{};
+    p.maxTurn = 0.05f;
+    p.senseAngle = 90.f;
+    p.senseMin = 30;
+    p.senseMax = 40;
+    p.fader = 0.99f;
+    p.diffusionCenter = 108.f / 128.f;
+    p.diffusionEdge = 4.f / 128.f;
+    p.diffusionCorner = 1.f / 128.f;
+    p.actorCount = 10000;
+    return p;
+}
+
+void setParameter(Parameters &parameters, const std::string &name, const std::string &value)
+{
+    if (name == "maxTurn")
+        parameters.maxTurn = parseValue<float>(name, value);
+    else if (name == "senseAngle")
+        parameters.senseAngle = parseValue<float>(name, value);
+    else if (name == "senseMin")
+        parameters.senseMin = parseValue<int>(name, value);
+    else if (name == "senseMax")
+        parameters.senseMax = parseValue<int>(name, value);
+    else if (name == "fader")
+        parameters.fader = parseValue<float>(name, value);
+    else if (name == "diffusionCenter")
+        parameters.diffusionCenter = parseValue<float>(name, value);
+    else if (name == "diffusionEdge")
+        parameters.diffusionEdge = parseValue<float>(name, value);
+    else if (name == "diffusionCorner")
+        parameters.diffusionCorner = parseValue<float>(name, value);
+    else if (name == "actorCount")
+        parameters.actorCount = parseValue<int>(name, value);
+    else
+        throw Exception(fmt::format("Unknown parameter '{}'", name));
+}
+
+void validate(const Parameters &parameters)
+{
+    // actor() divides the sense angle into this many steps, in float like there.
+    const float senseAngle = parameters.senseAngle * 3.14159265358979f / 180.f;
+    const float senseSteps = std::nearbyint(parameters.senseMax * senseAngle / 3);
+    if (parameters.senseMin < 0 || parameters.senseMin > parameters.senseMax || parameters.actorCount < 0
+            || !(senseSteps >= 1) || !(parameters.maxTurn >= 0))
+        throw Exception(fmt::format("Inconsistent parameters: {}", describe(parameters)));
+}
+
+std::vector<std::string> parameterNames()
+{
+    return {"maxTurn", "senseAngle", "senseMin", "senseMax", "fader", "diffusionCenter", "diffusionEdge",
+            "diffusionCorner", "actorCount"};
+}
+
+std::string describe(const Parameters &p)
+{
+    return fmt::format("maxTurn={} senseAngle={} senseMin={} senseMax={} fader={} diffusionCenter={} "
+                       "diffusionEdge={} diffusionCorner={} actorCount={}",
+                       p.maxTurn, p.senseAngle, p.senseMin, p.senseMax, p.fader, p.diffusionCenter,
+                       p.diffusionEdge, p.diffusionCorner, p.actorCount);
+}
+
+std::string csv(const Parameters &p)
+{
+    return fmt::format("{},{},{},{},{},{},{},{},{}", p.maxTurn, p.senseAngle, p.senseMin, p.senseMax, p.fader,
+                       p.diffusionCenter, p.diffusionEdge, p.diffusionCorner, p.actorCount);
+}
+
+std::vector<Parameters> loadParameterTable(const std::string &file)
+{
+    std::ifstream in(file);
+    if (!in)
+        throw Exception(fmt::format("Unable to open parameter table {}", file));
+
+    std::vector<Parameters> table;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string field;
+        Parameters parameters = defaultParameters();
+        bool empty = true;
+        while (fields >> field)
+        {
+            const std::size_t separator = field.find('=');
+            if (separator == std::string::npos)
+                throw Exception(fmt::format("Expected name=value in {}: '{}'", file, field));
+            setParameter(parameters, field.substr(0, separator), field.substr(separator + 1));
+            empty = false;
+        }
+        if (!empty)
+        {
+            validate(parameters);
+            table.push_back(parameters);
+        }
+    }
+    return table;
+}
+
+std::vector<Parameters> loadParameterGrid(const std::string &file)
+{
+    std::ifstream in(file);
+    if (!in)
+        throw Exception(fmt::format("Unable to open parameter grid {}", file));
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> axes;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        line = line.substr(0, line.find('#'));
+        const std::size_t separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                throw Exception(fmt::format("Expected name = values in {}: '{}'", file, line));
+            continue;
+        }
+
+        std::string name;
+        std::istringstream(line.substr(0, separator)) >> name;
+        std::vector<std::string> values;
+        std::istringstream fields(line.substr(separator + 1));
+        std::string field;
+        while (fields >> field)
+        {
+            const std::size_t from = field.find(':');
+            const std::size_t to = field.find(':', from + 1);
+            if (from == std::string::npos || to == std::string::npos)
+            {
+                values.push_back(field);
+                continue;
+            }
+            const double first = parseValue<double>(name, field.substr(0, from));
+            const double last = parseValue<double>(name, field.substr(from + 1, to - from - 1));
+            const double increment = parseValue<double>(name, field.substr(to + 1));
+            if (increment <= 0)
+                throw Exception(fmt::format("Range {} of {} needs a positive step", field, name));
+            // Half a step of slack so that rounding does not drop the last value.
+            for (double v = first; v <= last + increment / 2; v += increment)
+                values.push_back(fmt::format("{}", v));
+        }
+        if (values.empty())
+            throw Exception(fmt::format("No values for {} in {}", name, file));
+
+        // Validates the name early, before the product gets large.
+        Parameters probe = defaultParameters();
+        setParameter(probe, name, values.front());
+        axes.emplace_back(name, values);
+    }
+
+    std::vector<Parameters> grid{defaultParameters()};
+    for (const auto &[name, values] : axes)
+    {
+        std::vector<Parameters> expanded;
+        expanded.reserve(grid.size() * values.size());
+        for (const Parameters &base : grid)
+            for (const std::string &value : values)
+            {
+                Parameters p = base;
+                setParameter(p, name, value);
+                expanded.push_back(p);
+            }
+        grid = std::move(expanded);
+    }
+    for (const Parameters &p : grid)
+        validate(p);
+    return grid;
+}
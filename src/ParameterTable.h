@@ -0,0 +1,32 @@
+#pragma once
+
+#include "assets/Parameters.h"
+
+#include <string>
+#include <vector>
+
+// The values the kernels used to hard-code.
+[[nodiscard]] Parameters defaultParameters();
+
+// Sets a parameter by its field name, e.g. "maxTurn". Throws Exception for unknown names or malformed values.
+void setParameter(Parameters &parameters, const std::string &name, const std::string &value);
+
+// Throws Exception if the parameters cannot be simulated, e.g. senseMin > senseMax, a negative maxTurn or a
+// senseAngle too small for one sensor step at senseMax.
+void validate(const Parameters &parameters);
+
+[[nodiscard]] std::vector<std::string> parameterNames();
+
+[[nodiscard]] std::string describe(const Parameters &parameters);
+
+// Comma separated values in the order of parameterNames().
+[[nodiscard]] std::string csv(const Parameters &parameters);
+
+// Reads one ensemble member per non-empty line, written as whitespace separated name=value pairs. Fields not given
+// keep their defaults, '#' starts a comment.
+[[nodiscard]] std::vector<Parameters> loadParameterTable(const std::string &file);
+
+// Reads a parameter grid and returns its cartesian product. Each line names one parameter followed by its values,
+// either listed ("maxTurn = 0.02 0.05 0.1") or as an inclusive range ("senseMax = 20:60:10"). Parameters that are
+// not named keep their defaults.
+[[nodiscard]] std::vector<Parameters> loadParameterGrid(const std::string &file);
@@ -0,0 +1,116 @@
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+namespace
+{
+
+// Nearest rank percentile of sorted `values`.
+double percentile(const std::vector<double> &values, double p)
+{
+    const std::size_t rank = static_cast<std::size_t>(std::ceil(p / 100 * values.size()));
+    return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+}
+
+}
+
+void Profiler::setListener(Listener listener)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_listener = std::move(listener);
+}
+
+void Profiler::add(const std::string &name, const cl::Event &event, double items, const std::string &unit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back({name, event, items, unit});
+}
+
+void Profiler::poll(bool wait)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Pending> pending;
+    for (Pending &p : m_pending)
+    {
+        try
+        {
+            if (wait)
+                p.event.wait();
+            const cl_int status = p.event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+            if (status > CL_COMPLETE)
+            {
+                pending.push_back(std::move(p));
+                continue;
+            }
+            if (status < CL_COMPLETE)
+                continue;
+            const cl_ulong start = p.event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+            const cl_ulong end = p.event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+            Samples &samples = m_samples[p.name];
+            samples.seconds.push_back((end - start) * 1e-9);
+            samples.items += p.items;
+            samples.unit = p.unit;
+            if (m_listener)
+                m_listener(p.name, start, end);
+        }
+        catch (const cl::Error &error)
+        {
+            // e.g. a queue without profiling, or a failed command
+            std::cout << fmt::format("Profiling {} failed: {}({})", p.name, error.what(), error.err()) << std::endl;
+        }
+    }
+    m_pending = std::move(pending);
+}
+
+Profiler::Summary Profiler::summary(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_samples.find(name);
+    return it == m_samples.end() ? Summary() : summarize(it->second);
+}
+
+std::string Profiler::report() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string text = fmt::format("{:<16}{:>10}{:>12}{:>12}{:>12}  {}\n", "command", "launches", "p50 ms",
+                                   "p95 ms", "p99 ms", "throughput");
+    for (const auto &[name, samples] : m_samples)
+    {
+        if (samples.seconds.empty())
+            continue;
+        const Summary s = summarize(samples);
+        const std::string throughput = s.throughput > 0 ? fmt::format("{:.1f} M {}/s", s.throughput * 1e-6, s.unit)
+                                                        : "-";
+        text += fmt::format("{:<16}{:>10}{:>12.3f}{:>12.3f}{:>12.3f}  {}\n", name, s.launches, s.p50 * 1e3,
+                            s.p95 * 1e3, s.p99 * 1e3, throughput);
+    }
+    return text;
+}
+
+void Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples.clear();
+}
+
+Profiler::Summary Profiler::summarize(const Samples &samples)
+{
+    Summary s;
+    if (samples.seconds.empty())
+        return s;
+    std::vector<double> sorted = samples.seconds;
+    std::sort(sorted.begin(), sorted.end());
+    s.launches = sorted.size();
+    s.p50 = percentile(sorted, 50);
+    s.p95 = percentile(sorted, 95);
+    s.p99 = percentile(sorted, 99);
+    s.total = std::accumulate(sorted.begin(), sorted.end(), 0.);
+    s.throughput = samples.items > 0 && s.total > 0 ? samples.items / s.total : 0;
+    s.unit = samples.unit;
+    return s;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Times device commands from their profiling events without stalling the queue: events are only queried once they
+// have completed. Needs queues created with CL_QUEUE_PROFILING_ENABLE. Thread safe, so several queues may share one.
+class Profiler
+{
+public:
+    struct Summary
+    {
+        std::size_t launches = 0;
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+        // Sum of all durations, in seconds like the percentiles.
+        double total = 0;
+        // Work per second, 0 without items.
+        double throughput = 0;
+        std::string unit;
+    };
+
+    // Called by poll() for every timed command, with start and end on the device clock in nanoseconds.
+    using Listener = std::function<void(const std::string &name, cl_ulong start, cl_ulong end)>;
+
+    void setListener(Listener listener);
+
+    // Times `event` under `name`. `items` is the work the command does, e.g. cells, reported per second as `unit`.
+    void add(const std::string &name, const cl::Event &event, double items = 0, const std::string &unit = "");
+    // Takes the times of completed commands. With `wait`, blocks until all commands added so far are timed.
+    void poll(bool wait = false);
+
+    // Timings of `name` since the last reset(), all zero if there are none.
+    [[nodiscard]] Summary summary(const std::string &name) const;
+    // Launches, p50/p95/p99 duration and throughput per command name since the last reset().
+    [[nodiscard]] std::string report() const;
+    void reset();
+
+private:
+    struct Pending
+    {
+        std::string name;
+        cl::Event event;
+        double items = 0;
+        std::string unit;
+    };
+
+    struct Samples
+    {
+        std::vector<double> seconds;
+        double items = 0;
+        std::string unit;
+    };
+
+    [[nodiscard]] static Summary summarize(const Samples &samples);
+
+    mutable std::mutex m_mutex;
+    Listener m_listener;
+    std::vector<Pending> m_pending;
+    std::map<std::string, Samples> m_samples;
+};
@@ -0,0 +1,186 @@
+#include "ProgramBuilder.h"
+
+#include "Exception.h"
+#include "Hash.h"
+
+#include <fmt/core.h>
+
+#include <memory>
+
+namespace
+{
+
+struct CompileState
+{
+    std::promise<void> done;
+    std::once_flag finished;
+
+    // Both the callback and a failed clCompileProgram() may report completion, see ProgramBuilder::compile().
+    void finish()
+    {
+        std::call_once(finished, [this]() { done.set_value(); });
+    }
+};
+
+void CL_CALLBACK compileFinished(cl_program, void *data)
+{
+    // Owns one reference to the state, handed over by ProgramBuilder::compile().
+    std::unique_ptr<std::shared_ptr<CompileState>> state(static_cast<std::shared_ptr<CompileState> *>(data));
+    (*state)->finish();
+}
+
+}
+
+ProgramBuilder::ProgramBuilder(const cl::Context &context, const cl::Device &device, const ProgramCache &cache,
+                               std::string options, SourceLookup lookup) :
+    m_context(context),
+    m_device(device),
+    m_cache(cache),
+    m_options(std::move(options))
+{
+    // Looked up once, so that the hash matches what gets compiled even if the files change meanwhile.
+    Hash hash;
+    for (const std::string &name : librarySources())
+    {
+        m_librarySources.push_back(lookup(name));
+        hash.add(&m_librarySources.back().hash, sizeof(m_librarySources.back().hash));
+    }
+    m_libraryHash = hash.value();
+}
+
+ProgramBuilder::~ProgramBuilder()
+{
+    // Waits without holding the lock, running builds take it in library(). The library is only started by them, so
+    // it is looked at once they are done.
+    std::vector<std::shared_future<cl::Program>> builds;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        builds = m_builds;
+    }
+    for (const std::shared_future<cl::Program> &build : builds)
+        build.wait();
+
+    std::shared_future<cl::Program> libraryBuild;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        libraryBuild = m_libraryBuild;
+    }
+    if (libraryBuild.valid())
+        libraryBuild.wait();
+}
+
+std::shared_future<cl::Program> ProgramBuilder::build(const ProgramSource &source)
+{
+    Hash hash;
+    hash.add(&source.hash, sizeof(source.hash));
+    hash.add(&m_libraryHash, sizeof(m_libraryHash));
+    const std::string key = ProgramCache::key(m_device, source.name, hash.value(), m_options);
+
+    std::shared_future<cl::Program> build = std::async(std::launch::async, [this, source, key]()
+    {
+        cl::Program program = m_cache.find(m_context, m_device, key);
+        if (program())
+            return program;
+
+        // Both compiles are already running when we start waiting for the first.
+        const std::shared_future<cl::Program> compiled = compile(source);
+        const std::shared_future<cl::Program> library = this->library();
+        program = link(source.name, {compiled.get(), library.get()}, "");
+        m_cache.store(program, key);
+        return program;
+    }).share();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_builds.push_back(build);
+    return build;
+}
+
+const std::vector<std::string> &ProgramBuilder::librarySources()
+{
+    static const std::vector<std::string> sources = {"Common.cl", "Random.cl"};
+    return sources;
+}
+
+std::shared_future<cl::Program> ProgramBuilder::compile(const ProgramSource &source) const
+{
+    cl::Program program;
+    try
+    {
+        program = cl::Program(m_context, cl::Program::Sources(1, source.source));
+    }
+    catch (const cl::Error &error)
+    {
+        throw Exception(fmt::format("Failed to create program {}: {}({})", source.name, error.what(), error.err()));
+    }
+
+    auto state = std::make_shared<CompileState>();
+    std::shared_future<void> done = state->done.get_future().share();
+    auto *callbackState = new std::shared_ptr<CompileState>(state);
+    const cl_device_id device = m_device();
+    const cl_int errCode = clCompileProgram(program(), 1, &device, m_options.c_str(), 0, nullptr, nullptr,
+                                            compileFinished, callbackState);
+    if (errCode == CL_COMPILE_PROGRAM_FAILURE)
+    {
+        // A compile was started: runtimes that compile synchronously have already called back, which freed the
+        // callback state, others may still do so. Either way the build status below has the error.
+        state->finish();
+    }
+    else if (errCode != CL_SUCCESS)
+    {
+        // No compile was started, so there is no callback.
+        delete callbackState;
+        throw Exception(fmt::format("Failed to compile {}: {}", source.name, errCode));
+    }
+
+    const std::string name = source.name;
+    const cl::Device clDevice = m_device;
+    return std::async(std::launch::deferred, [program, done, name, clDevice]()
+    {
+        done.wait();
+        if (program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(clDevice) != CL_BUILD_SUCCESS)
+            throw Exception(fmt::format("Compiling {} failed\nLog:\n{}", name,
+                                        program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(clDevice)));
+        return program;
+    }).share();
+}
+
+std::shared_future<cl::Program> ProgramBuilder::library()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_libraryBuild.valid())
+        return m_libraryBuild;
+
+    std::vector<std::shared_future<cl::Program>> compiled;
+    for (const ProgramSource &source : m_librarySources)
+        compiled.push_back(compile(source));
+    m_libraryBuild = std::async(std::launch::async, [this, compiled]()
+    {
+        std::vector<cl::Program> objects;
+        for (const std::shared_future<cl::Program> &object : compiled)
+            objects.push_back(object.get());
+        return link("kernel library", objects, "-create-library");
+    }).share();
+    return m_libraryBuild;
+}
+
+cl::Program ProgramBuilder::link(const std::string &name, const std::vector<cl::Program> &programs,
+                                 const std::string &options) const
+{
+    // The C API, because the C++ wrapper drops the program, and with it the build log, when linking fails.
+    std::vector<cl_program> handles;
+    for (const cl::Program &program : programs)
+        handles.push_back(program());
+    const cl_device_id device = m_device();
+    cl_int errCode = CL_SUCCESS;
+    const cl::Program program(clLinkProgram(m_context(), 1, &device, options.c_str(),
+                                            static_cast<cl_uint>(handles.size()), handles.data(), nullptr, nullptr,
+                                            &errCode));
+    if (errCode != CL_SUCCESS)
+    {
+        std::string log;
+        if (program())
+            log = program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device);
+        throw Exception(fmt::format("Linking {} failed: {}\nLog:\n{}", name, errCode, log));
+    }
+    return program;
+}
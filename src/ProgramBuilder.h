@@ -0,0 +1,54 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "ProgramCache.h"
+#include "ProgramSource.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Builds kernel programs in the background. The helpers in Common.cl and Random.cl are compiled once into a library
+// that is linked into every program. Compiles are started right away and report completion through build callbacks,
+// so all of them run concurrently while the caller goes on. Linked programs go through the program cache.
+class ProgramBuilder
+{
+public:
+    // Where the library sources come from, embeddedSource() or a loader for reloading from disk.
+    using SourceLookup = std::function<ProgramSource(const std::string &name)>;
+
+    // `options` are passed to every compile, `cache` has to outlive the builder.
+    ProgramBuilder(const cl::Context &context, const cl::Device &device, const ProgramCache &cache,
+                   std::string options = "", SourceLookup lookup = embeddedSource);
+    // Waits for builds still running.
+    ~ProgramBuilder();
+
+    ProgramBuilder(const ProgramBuilder &) = delete;
+    ProgramBuilder &operator=(const ProgramBuilder &) = delete;
+
+    // Starts building `source` and returns immediately. The future throws Exception with the build log on failure.
+    [[nodiscard]] std::shared_future<cl::Program> build(const ProgramSource &source);
+
+    // Sources compiled into the shared library.
+    [[nodiscard]] static const std::vector<std::string> &librarySources();
+
+private:
+    [[nodiscard]] std::shared_future<cl::Program> compile(const ProgramSource &source) const;
+    [[nodiscard]] std::shared_future<cl::Program> library();
+    [[nodiscard]] cl::Program link(const std::string &name, const std::vector<cl::Program> &programs,
+                                   const std::string &options) const;
+
+    cl::Context m_context;
+    cl::Device m_device;
+    const ProgramCache &m_cache;
+    const std::string m_options;
+    std::vector<ProgramSource> m_librarySources;
+    std::uint64_t m_libraryHash = 0;
+
+    std::mutex m_mutex;
+    std::shared_future<cl::Program> m_libraryBuild;
+    std::vector<std::shared_future<cl::Program>> m_builds;
+};
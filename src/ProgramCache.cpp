@@ -0,0 +1,131 @@
+#include "ProgramCache.h"
+
+#include "Exception.h"
+#include "Hash.h"
+
+#include <fmt/core.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+std::string environment(const char *name)
+{
+    const char *value = std::getenv(name);
+    return value ? value : "";
+}
+
+}
+
+ProgramCache::ProgramCache(std::string directory) :
+    m_directory(std::move(directory))
+{ }
+
+std::string ProgramCache::defaultDirectory()
+{
+#ifdef OS_WIN
+    const std::string base = environment("LOCALAPPDATA");
+    return base.empty() ? "" : (fs::path(base) / "OpenClPlayground").string();
+#else
+    const std::string xdg = environment("XDG_CACHE_HOME");
+    if (!xdg.empty())
+        return (fs::path(xdg) / "OpenClPlayground").string();
+    const std::string home = environment("HOME");
+    return home.empty() ? "" : (fs::path(home) / ".cache" / "OpenClPlayground").string();
+#endif
+}
+
+std::string ProgramCache::key(const cl::Device &device, const std::string &name, std::uint64_t sourceHash,
+                              const std::string &options)
+{
+    Hash hash;
+    hash.add(device.getInfo<CL_DEVICE_NAME>());
+    hash.add(device.getInfo<CL_DEVICE_VERSION>());
+    hash.add(device.getInfo<CL_DRIVER_VERSION>());
+    hash.add(options);
+    hash.add(&sourceHash, sizeof(sourceHash));
+    return fmt::format("{}-{:016x}", fs::path(name).stem().string(), hash.value());
+}
+
+bool ProgramCache::enabled() const
+{
+    return !m_directory.empty();
+}
+
+const std::string &ProgramCache::directory() const
+{
+    return m_directory;
+}
+
+cl::Program ProgramCache::find(const cl::Context &context, const cl::Device &device, const std::string &key) const
+{
+    if (!enabled())
+        return cl::Program();
+
+    const std::string path = this->path(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return cl::Program();
+    const std::vector<unsigned char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return cl::Program();
+
+    try
+    {
+        const std::vector<cl::Device> devices(1, device);
+        std::vector<cl_int> status;
+        cl::Program program(context, devices, cl::Program::Binaries(1, binary), &status);
+        // A binary still has to be built, which is cheap for executables.
+        program.build(devices);
+        return program;
+    }
+    catch (const cl::Error &error)
+    {
+        // Stale or foreign binary, e.g. after a driver update that kept its version string.
+        std::cout << fmt::format("Ignoring cached program {}: {}({})", path, error.what(), error.err()) << std::endl;
+        return cl::Program();
+    }
+}
+
+void ProgramCache::store(const cl::Program &program, const std::string &key) const
+{
+    if (!enabled())
+        return;
+
+    const std::string path = this->path(key);
+    try
+    {
+        const cl::Program::Binaries binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+        if (binaries.size() != 1 || binaries.front().empty())
+            return;
+
+        fs::create_directories(fs::path(path).parent_path());
+        // Written next to the final name and renamed, so that concurrent runs never read half a file.
+        const std::string temporary = fmt::format("{}.{:08x}.tmp", path, std::random_device()());
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            out.write(reinterpret_cast<const char *>(binaries.front().data()), binaries.front().size());
+            if (!out)
+                throw Exception(fmt::format("Writing {} failed", temporary));
+        }
+        fs::rename(temporary, path);
+    }
+    catch (const std::exception &e)
+    {
+        // The cache is an optimization, a failure to write it is not fatal.
+        std::cout << fmt::format("Unable to cache program in {}: {}", path, e.what()) << std::endl;
+    }
+}
+
+std::string ProgramCache::path(const std::string &key) const
+{
+    return (fs::path(m_directory) / (key + ".bin")).string();
+}
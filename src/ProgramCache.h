@@ -0,0 +1,36 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+
+#include <cstdint>
+#include <string>
+
+// Keeps built program binaries on disk, keyed by device, driver, build options and the hash of the program sources
+// (which have their includes inlined). A hit loads the binary with clCreateProgramWithBinary instead of compiling.
+class ProgramCache
+{
+public:
+    // An empty directory disables the cache.
+    explicit ProgramCache(std::string directory = defaultDirectory());
+
+    // $XDG_CACHE_HOME/OpenClPlayground, ~/.cache/OpenClPlayground or %LOCALAPPDATA%\OpenClPlayground.
+    [[nodiscard]] static std::string defaultDirectory();
+
+    // Key of a program called `name`, made from sources hashing to `sourceHash` and built for `device` with
+    // `options`.
+    [[nodiscard]] static std::string key(const cl::Device &device, const std::string &name, std::uint64_t sourceHash,
+                                         const std::string &options);
+
+    [[nodiscard]] bool enabled() const;
+    [[nodiscard]] const std::string &directory() const;
+
+    // The cached program for `key`, already built, or a null program if there is none.
+    [[nodiscard]] cl::Program find(const cl::Context &context, const cl::Device &device, const std::string &key) const;
+    // Stores the binary of the built `program`. Failures are reported but not fatal.
+    void store(const cl::Program &program, const std::string &key) const;
+
+private:
+    [[nodiscard]] std::string path(const std::string &key) const;
+
+    std::string m_directory;
+};
@@ -0,0 +1,100 @@
+#include "ProgramSource.h"
+
+#include "Exception.h"
+#include "Hash.h"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Name of a quoted include on `line`, or empty.
+std::string includedName(const std::string &line)
+{
+    std::istringstream in(line);
+    std::string directive;
+    in >> directive;
+    if (directive == "#")
+    {
+        std::string rest;
+        in >> rest;
+        directive += rest;
+    }
+    if (directive != "#include")
+        return "";
+    std::string name;
+    in >> name;
+    if (name.size() < 3 || name.front() != '"' || name.back() != '"')
+        return "";
+    return name.substr(1, name.size() - 2);
+}
+
+bool isPragmaOnce(const std::string &line)
+{
+    std::istringstream in(line);
+    std::string directive, pragma, once;
+    in >> directive;
+    if (directive == "#")
+        in >> pragma;
+    else if (directive == "#pragma")
+        pragma = "pragma";
+    in >> once;
+    return pragma == "pragma" && once == "once";
+}
+
+void resolveIncludes(const fs::path &file, const fs::path &directory, std::set<fs::path> &included,
+                     std::string &result)
+{
+    const fs::path canonical = fs::weakly_canonical(file);
+    if (!included.insert(canonical).second)
+        return;
+
+    std::ifstream in(file);
+    if (!in)
+        throw Exception(fmt::format("Cannot read {}", file.string()));
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (isPragmaOnce(line))
+            continue;
+        const std::string name = includedName(line);
+        if (name.empty())
+        {
+            result += line;
+            result += '\n';
+            continue;
+        }
+        fs::path path = file.parent_path() / name;
+        if (!fs::exists(path))
+            path = directory / name;
+        if (!fs::exists(path))
+            throw Exception(fmt::format("{}: cannot resolve #include \"{}\"", file.string(), name));
+        resolveIncludes(path, directory, included, result);
+    }
+}
+
+}
+
+const ProgramSource &embeddedSource(const std::string &name)
+{
+    for (const ProgramSource &source : embeddedSources())
+        if (source.name == name)
+            return source;
+    throw Exception(fmt::format("No embedded source {}", name));
+}
+
+ProgramSource loadProgramSource(const std::string &directory, const std::string &name)
+{
+    ProgramSource source{name, "", 0};
+    std::set<fs::path> included;
+    resolveIncludes(fs::path(directory) / name, directory, included, source.source);
+    source.hash = Hash().add(source.source).value();
+    return source;
+}
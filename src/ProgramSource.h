@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Source text of a device program or shader with all quoted #includes inlined, and a hash of exactly that text.
+struct ProgramSource
+{
+    std::string name;
+    std::string source;
+    std::uint64_t hash;
+};
+
+// Everything in assets/, embedded at build time by cmake/EmbedKernels.cmake.
+[[nodiscard]] const std::vector<ProgramSource> &embeddedSources();
+
+// Looks up an embedded source by file name, e.g. "Board.cl". Throws Exception if there is none.
+[[nodiscard]] const ProgramSource &embeddedSource(const std::string &name);
+
+// Reads `name` from `directory` and inlines its includes the same way cmake/EmbedKernels.cmake does, for reloading
+// programs at runtime. The hash is not comparable to the embedded ones. Throws Exception if a file cannot be read.
+[[nodiscard]] ProgramSource loadProgramSource(const std::string &directory, const std::string &name);
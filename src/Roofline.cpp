@@ -0,0 +1,161 @@
+#include "Roofline.h"
+
+#include "Exception.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "assets/Actor.h"
+#include "assets/Cell.h"
+#include "assets/Peak.h"
+#include "assets/Pyramid.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+const int measureRuns = 5;
+const double pi = 3.14159265358979323846;
+
+// Operation counts of the kernels, transcendental functions counted as one.
+// board(): 9 multiplies and 8 adds for the stencil, 1 multiply for the fader.
+const double boardFlopsPerCell = 18;
+// actor(): a rotated direction per sensor ray, and a scaled and offset position, rounding and cell evaluation per
+// sample on it.
+const double actorFlopsPerRay = 10;
+const double actorFlopsPerSample = 9;
+// senseCoarse(): the level, the block's position and its bounds check, and the weighted add.
+const double actorFlopsPerCoarseSample = 12;
+// Direction, speed and position update, the look ahead and the deposit.
+const double actorFlopsPerActor = 40;
+// Reads of the cell ahead, the cell moved to and the deposit's read and write.
+const double actorCellAccessesPerActor = 4;
+
+double bestSeconds(const cl::CommandQueue &queue, const cl::Kernel &kernel, const cl::NDRange &global)
+{
+    double best = 0;
+    for (int run = 0; run < measureRuns; ++run)
+    {
+        cl::Event event;
+        queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange, nullptr, &event);
+        event.wait();
+        const double seconds = (event.getProfilingInfo<CL_PROFILING_COMMAND_END>()
+                                - event.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+        // The first run pays for first touches of the buffers.
+        if (run > 0 && (best == 0 || seconds < best))
+            best = seconds;
+    }
+    return best;
+}
+
+std::string line(const std::string &name, const Profiler::Summary &summary, const KernelCost &cost,
+                 const DevicePeak &peak)
+{
+    if (summary.launches == 0 || summary.throughput <= 0)
+        return fmt::format("{:<10}not timed\n", name);
+    const double bytesPerSecond = cost.bytes * summary.throughput;
+    const double flopsPerSecond = cost.flops * summary.throughput;
+    const double intensity = cost.flops / cost.bytes;
+    // Below the ridge point the memory system runs out first.
+    const double ridge = peak.flopsPerSecond / peak.bytesPerSecond;
+    return fmt::format("{:<10}{:>10.1f} GB/s ({:>3.0f}%){:>10.1f} GFLOP/s ({:>3.0f}%){:>10.2f} flop/B  {}-bound\n",
+                       name, bytesPerSecond * 1e-9, 100 * bytesPerSecond / peak.bytesPerSecond,
+                       flopsPerSecond * 1e-9, 100 * flopsPerSecond / peak.flopsPerSecond, intensity,
+                       intensity < ridge ? "memory" : "compute");
+}
+
+// Pyramid reads of senseCoarse() for the samples from `from` to `to`.
+int coarseSamples(int from, int to)
+{
+    int samples = 0;
+    for (int j = from; j <= to; j += 1 << std::clamp(std::ilogb(j / 4.f), 2, PYRAMID_LEVELS))
+        ++samples;
+    return samples;
+}
+
+}
+
+KernelCost boardCost()
+{
+    return {2. * sizeof(Cell), boardFlopsPerCell};
+}
+
+KernelCost actorCost(const std::vector<Parameters> &members, int actorsPerMember, int pyramidFrom)
+{
+    KernelCost total;
+    for (const Parameters &p : members)
+    {
+        // The sensor loops of actor(), see there.
+        const double senseAngle = p.senseAngle * pi / 180;
+        const int senseSteps = std::min(static_cast<int>(std::lround(p.senseMax * senseAngle / 3)), 999);
+        const double rays = senseSteps + 1;
+        const int fineMax = pyramidFrom > 0 ? std::min(p.senseMax, std::max(pyramidFrom, p.senseMin) - 1) : p.senseMax;
+        const int fineSamples = fineMax >= p.senseMin ? (fineMax - p.senseMin) / 3 + 1 : 0;
+        const int coarseFrom = p.senseMin + 3 * fineSamples;
+        const double samplesPerRay = fineSamples;
+        const double coarsePerRay = pyramidFrom > 0 ? coarseSamples(coarseFrom, p.senseMax) : 0;
+        const double cellAccesses = rays * samplesPerRay + actorCellAccessesPerActor;
+        total.bytes += p.actorCount * (2. * sizeof(Actor) + cellAccesses * sizeof(Cell)
+                                       + rays * coarsePerRay * sizeof(float));
+        total.flops += p.actorCount * (rays * (actorFlopsPerRay + samplesPerRay * actorFlopsPerSample
+                                               + coarsePerRay * actorFlopsPerCoarseSample) + actorFlopsPerActor);
+    }
+    const double slots = static_cast<double>(actorsPerMember) * members.size();
+    if (slots > 0)
+    {
+        total.bytes /= slots;
+        total.flops /= slots;
+    }
+    return total;
+}
+
+DevicePeak DevicePeak::measure(const cl::Context &context, const cl::Device &device, const cl::Program &program)
+{
+    const cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE);
+    DevicePeak peak;
+
+    // Large enough to stream past any cache, small enough for every device.
+    const cl_ulong maxAllocation = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+    const int elements = static_cast<int>(std::min<cl_ulong>(64 << 20, maxAllocation) / sizeof(float));
+    const cl::Buffer a(context, CL_MEM_READ_WRITE, elements * sizeof(float));
+    const cl::Buffer b(context, CL_MEM_READ_WRITE, elements * sizeof(float));
+    const cl::Buffer c(context, CL_MEM_READ_WRITE, elements * sizeof(float));
+    queue.enqueueFillBuffer(b, 1.f, 0, elements * sizeof(float));
+    queue.enqueueFillBuffer(c, 2.f, 0, elements * sizeof(float));
+    cl::Kernel triad(program, "triad");
+    triad.setArg(0, a);
+    triad.setArg(1, b);
+    triad.setArg(2, c);
+    triad.setArg(3, 3.f);
+    triad.setArg(4, elements);
+    const double triadSeconds = bestSeconds(queue, triad, cl::NDRange(elements));
+    if (triadSeconds > 0)
+        peak.bytesPerSecond = 3. * sizeof(float) * elements / triadSeconds;
+
+    const int items = 1 << 20;
+    const cl::Buffer out(context, CL_MEM_WRITE_ONLY, items * sizeof(float));
+    cl::Kernel arithmetic(program, "arithmetic");
+    arithmetic.setArg(0, out);
+    arithmetic.setArg(1, .999f);
+    arithmetic.setArg(2, .001f);
+    const double arithmeticSeconds = bestSeconds(queue, arithmetic, cl::NDRange(items));
+    if (arithmeticSeconds > 0)
+        peak.flopsPerSecond = 2. * PEAK_CHAINS * PEAK_ITERATIONS * items / arithmeticSeconds;
+
+    if (peak.bytesPerSecond <= 0 || peak.flopsPerSecond <= 0)
+        throw Exception("Measuring the device peaks failed, the timer shows no time");
+    return peak;
+}
+
+std::string rooflineReport(const Profiler &profiler, const DevicePeak &peak, const Simulation &simulation)
+{
+    return fmt::format("Roofline against {:.1f} GB/s and {:.1f} GFLOP/s:\n", peak.bytesPerSecond * 1e-9,
+                       peak.flopsPerSecond * 1e-9)
+           + line("board", profiler.summary("board"), boardCost(), peak)
+           + line("actor", profiler.summary("actor"),
+                  actorCost(simulation.parameters(), simulation.actorsPerMember(), simulation.pyramidFrom()), peak)
+           + (simulation.sparse() ? "The sparse board pass is credited with every cell, its rates are effective ones "
+                                    "above what the device achieved.\n" : "");
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "assets/Parameters.h"
+
+#include <string>
+#include <vector>
+
+class Profiler;
+class Simulation;
+
+// Bytes moved and floating point operations per work item of a kernel, from a model of its source.
+struct KernelCost
+{
+    double bytes = 0;
+    double flops = 0;
+};
+
+// Per cell of board() in Board.cl. Neighbour reads are assumed to hit the cache, so a cell is read and written once.
+[[nodiscard]] KernelCost boardCost();
+// Per actor slot of actor() in Actor.cl, averaged over `members` with `actorsPerMember` slots each. Every actor up
+// to a member's actorCount is taken as alive; most of the cost is the sensor samples. With `pyramidFrom`, samples
+// from that distance on read the pyramid as senseCoarse() does.
+[[nodiscard]] KernelCost actorCost(const std::vector<Parameters> &members, int actorsPerMember, int pyramidFrom = 0);
+
+// What a device can do at most, measured with the microbenchmarks in Peak.cl.
+struct DevicePeak
+{
+    double bytesPerSecond = 0;
+    double flopsPerSecond = 0;
+
+    // Runs a streaming triad and a multiply-add kernel from `program` (built from Peak.cl) a few times on a profiling
+    // queue of its own and keeps the best runs.
+    [[nodiscard]] static DevicePeak measure(const cl::Context &context, const cl::Device &device,
+                                            const cl::Program &program);
+};
+
+// Achieved bandwidth and arithmetic rate of the board and actor launches timed by `profiler` since its last reset,
+// against `peak`, and which of the two limits each kernel.
+[[nodiscard]] std::string rooflineReport(const Profiler &profiler, const DevicePeak &peak,
+                                         const Simulation &simulation);
@@ -0,0 +1,235 @@
+#include "Settings.h"
+
+#include "Exception.h"
+
+#include <fmt/core.h>
+
+#include <sstream>
+
+namespace
+{
+
+template<typename T>
+T parseOption(const std::string &name, const std::string &value)
+{
+    std::istringstream in(value);
+    T result{};
+    in >> result;
+    if (value.empty() || in.fail() || !in.eof())
+        throw Exception(fmt::format("Invalid value '{}' for option --{}", value, name));
+    return result;
+}
+
+int parsePositive(const std::string &name, const std::string &value)
+{
+    const int result = parseOption<int>(name, value);
+    if (result < 1)
+        throw Exception(fmt::format("--{} needs a positive value", name));
+    return result;
+}
+
+SpawnShape parseSpawnShape(const std::string &name, const std::string &value)
+{
+    if (value == "disc")
+        return SPAWN_DISC;
+    if (value == "box")
+        return SPAWN_BOX;
+    if (value == "mask")
+        return SPAWN_MASK;
+    throw Exception(fmt::format("Invalid value '{}' for option --{}, expected disc, box or mask", value, name));
+}
+
+}
+
+Settings Settings::parse(int argc, char **argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+            throw Exception(fmt::format("Unexpected argument '{}'", arg));
+        const std::size_t separator = arg.find('=');
+        const std::string name = arg.substr(2, separator == std::string::npos ? std::string::npos : separator - 2);
+        const std::string value = separator == std::string::npos ? std::string() : arg.substr(separator + 1);
+        settings.set(name, value);
+    }
+    if (settings.seek && (settings.keyframes.empty() || *settings.seek < 0))
+        throw Exception("--seek needs --keyframes and a generation of 0 or more");
+    // A restore activates every tile and rebuilds the pyramid from the restored board, neither is what the original
+    // run had at that generation.
+    if (settings.sparse && settings.deterministic)
+        throw Exception("--sparse does not work with --deterministic, --checksum or --keyframes");
+    if (settings.pyramidFrom > 0 && settings.deterministic)
+        throw Exception("--pyramid does not work with --deterministic, --checksum or --keyframes");
+    // Strips run the dense passes only, and each would place a mask spawned population on free cells of its own rows.
+    if (!settings.strips.empty() && (settings.sparse || settings.pyramidFrom > 0 || settings.deterministic
+                                     || settings.seed || settings.spawn == SPAWN_MASK))
+        throw Exception("--strips does not work with --sparse, --pyramid, --deterministic, --seed or --spawn=mask");
+    return settings;
+}
+
+std::string Settings::usage()
+{
+    return "Options:\n"
+           "  --ensemble=N        simulate N independent boards in the same launches\n"
+           "  --parameters=FILE   per member parameters, one line of name=value pairs per member\n"
+           "  --display=I         ensemble member shown in the window (keys 1-9 switch at runtime)\n"
+           "  --width=W           board width (default: monitor width - 100)\n"
+           "  --height=H          board height (default: monitor height - 100)\n"
+           "  --actors=N          actors of every member (default: 10000 or the parameters), the [ and ] keys halve\n"
+           "                      and double it while running\n"
+           "  --spawn=SHAPE       where actors start: disc (default), box or mask (anywhere not solid)\n"
+           "  --sparse            blur only tiles with actors or trail above 1/256 and their neighbours, fainter\n"
+           "                      trail stays instead of fading; also works with --sweep, not when deterministic\n"
+           "  --pyramid[=D]       sense from distance D (default 16) on in a pyramid of averaged trail instead of\n"
+           "                      every third cell, which makes a large senseMax cheap; also works with --sweep,\n"
+           "                      not when deterministic\n"
+           "  --pyramid-every=N   generations between pyramid rebuilds (default 4)\n"
+           "  --deterministic     bit identical runs for the same seed on the same device, at some cost in speed\n"
+           "  --seed=N            seed of the actor population (default: 1 with --deterministic, otherwise the clock)\n"
+           "  --checksum=N        simulate N generations headless in deterministic mode on every OpenCL device and\n"
+           "                      print a checksum of the state; the H key prints it for the window\n"
+           "  --keyframes=DIR     keep keyframes of the run in DIR to seek in it later (implies --deterministic)\n"
+           "  --keyframe-every=N  generations between keyframes (default 10000)\n"
+           "  --keyframe-budget=MB\n"
+           "                      disk space in MiB of the keyframes, beyond it every other one goes (default 4096)\n"
+           "  --seek=G            start at generation G from the nearest keyframe, also with --checksum\n"
+           "  --checkpoint=FILE   where the S key and --checkpoint-every save the state (default slime.checkpoint)\n"
+           "  --checkpoint-every=N\n"
+           "                      write a checkpoint every N generations\n"
+           "  --restore=FILE      continue from a checkpoint; board size and parameters come from the file\n"
+           "  --snapshot-prefix=P snapshots taken with the P key go to P-<generation>.snapshot (default slime)\n"
+           "  --capture=PATH      record the window from the start, PATH.y4m as video, otherwise as PATH-N.ppm;\n"
+           "                      the C key starts and stops recording (default capture.y4m)\n"
+           "  --telemetry=FILE    write on-device statistics of every member to FILE, as JSON lines if it ends in\n"
+           "                      .jsonl or .json, otherwise as CSV; also works with --sweep\n"
+           "  --telemetry-every=N generations between telemetry lines (default 100)\n"
+           "  --profile[=SECONDS] time every kernel launch on the device and print percentiles and throughput every\n"
+           "                      SECONDS (default 5) and on exit; also works with --sweep\n"
+           "  --roofline          add achieved GB/s and GFLOP/s of the kernels against the device peaks to the profile\n"
+           "                      (implies --profile)\n"
+           "  --trace=FILE        write a timeline of host and device activity for chrome://tracing or Perfetto\n"
+           "  --program-cache=DIR where built kernels are cached, 'off' disables (default: user cache directory)\n"
+           "  --tune=MODE         work-group sizes: on (tuned once per device and cached, default), again (tune\n"
+           "                      anew) or off (fixed 16 and 16x16)\n"
+           "  --watch-kernels[=DIR]\n"
+           "                      rebuild and swap in the kernels when the sources in DIR change (default: assets/)\n"
+           "\n"
+           "Headless parameter sweep:\n"
+           "  --sweep=FILE        parameter grid, one 'name = values' or 'name = from:to:step' line per parameter\n"
+           "  --generations=N     generations per configuration (default 10000)\n"
+           "  --output=FILE       CSV file with one line of statistics per configuration (default sweep.csv)\n"
+           "  --batch=N           configurations simulated together as one ensemble (default 8)\n"
+           "  --jobs-per-device=N concurrent jobs per OpenCL device (default 2)\n"
+           "\n"
+           "Headless multi-device run:\n"
+           "  --strips=DEVICES    split one board into horizontal strips over all GPUs (gpu), all OpenCL devices\n"
+           "                      (all) or N parts of the CPU (cpu:N) and simulate --generations generations;\n"
+           "                      not with --sparse, --pyramid, --deterministic, --seed or --spawn=mask\n"
+           "\n"
+           "  --help              print this text\n";
+}
+
+void Settings::set(const std::string &name, const std::string &value)
+{
+    if (name == "ensemble")
+        ensembleSize = parsePositive(name, value);
+    else if (name == "parameters")
+        parameterTable = value;
+    else if (name == "display")
+        displayMember = parseOption<int>(name, value);
+    else if (name == "width")
+        boardWidth = parsePositive(name, value);
+    else if (name == "height")
+        boardHeight = parsePositive(name, value);
+    else if (name == "actors")
+        actorCount = parseOption<int>(name, value);
+    else if (name == "spawn")
+        spawn = parseSpawnShape(name, value);
+    else if (name == "sweep")
+        sweep = value;
+    else if (name == "generations")
+        sweepGenerations = parsePositive(name, value);
+    else if (name == "output")
+        sweepOutput = value;
+    else if (name == "batch")
+        sweepBatch = parsePositive(name, value);
+    else if (name == "jobs-per-device")
+        sweepJobsPerDevice = parsePositive(name, value);
+    else if (name == "strips")
+    {
+        if (value != "gpu" && value != "all" && value.rfind("cpu:", 0) != 0)
+            throw Exception(fmt::format("Invalid value '{}' for option --{}, expected gpu, all or cpu:N", value, name));
+        strips = value;
+    }
+    else if (name == "sparse")
+        sparse = true;
+    else if (name == "pyramid")
+        pyramidFrom = value.empty() ? 16 : parsePositive(name, value);
+    else if (name == "pyramid-every")
+        pyramidInterval = parsePositive(name, value);
+    else if (name == "deterministic")
+        deterministic = true;
+    else if (name == "seed")
+        seed = parseOption<std::uint64_t>(name, value);
+    else if (name == "checksum")
+    {
+        checksumGenerations = parsePositive(name, value);
+        deterministic = true;
+    }
+    else if (name == "keyframes")
+    {
+        keyframes = value;
+        deterministic = true;
+    }
+    else if (name == "keyframe-every")
+        keyframeInterval = parsePositive(name, value);
+    else if (name == "keyframe-budget")
+        keyframeBudget = parsePositive(name, value);
+    else if (name == "seek")
+        seek = parseOption<int>(name, value);
+    else if (name == "checkpoint")
+        checkpoint = value;
+    else if (name == "checkpoint-every")
+        checkpointInterval = parsePositive(name, value);
+    else if (name == "restore")
+        restore = value;
+    else if (name == "snapshot-prefix")
+        snapshotPrefix = value;
+    else if (name == "capture")
+        capture = value;
+    else if (name == "telemetry")
+        telemetry = value;
+    else if (name == "telemetry-every")
+        telemetryInterval = parsePositive(name, value);
+    else if (name == "profile")
+    {
+        profileInterval = value.empty() ? 5 : parseOption<double>(name, value);
+        if (profileInterval <= 0)
+            throw Exception(fmt::format("--{} needs a positive value", name));
+    }
+    else if (name == "roofline")
+    {
+        roofline = true;
+        if (profileInterval == 0)
+            profileInterval = 5;
+    }
+    else if (name == "trace")
+        trace = value;
+    else if (name == "program-cache")
+        programCache = value == "off" ? std::string() : value;
+    else if (name == "tune")
+    {
+        if (value != "on" && value != "off" && value != "again")
+            throw Exception(fmt::format("Invalid value '{}' for option --{}, expected on, off or again", value, name));
+        tune = value != "off";
+        retune = value == "again";
+    }
+    else if (name == "watch-kernels")
+        watchKernels = value.empty() ? ASSETS_DIR : value;
+    else if (name == "help")
+        help = true;
+    else
+        throw Exception(fmt::format("Unknown option --{}", name));
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "assets/Spawn.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Runtime options, given on the command line as --name=value.
+struct Settings
+{
+    // Number of independent boards simulated side by side. 0 takes the size of the parameter table, or 1.
+    int ensembleSize = 0;
+    // File with one line of name=value parameters per ensemble member, see loadParameterTable().
+    std::string parameterTable;
+    // Ensemble member shown in the window.
+    int displayMember = 0;
+    // Board size, 0 derives it from the monitor (or a default when headless).
+    int boardWidth = 0;
+    int boardHeight = 0;
+    // Actors of every member, overriding the parameters. Changed at runtime with the [ and ] keys.
+    std::optional<int> actorCount;
+    // Region the actors start in.
+    SpawnShape spawn = SPAWN_DISC;
+
+    // Parameter grid to sweep headless instead of opening a window, see loadParameterGrid().
+    std::string sweep;
+    int sweepGenerations = 10000;
+    std::string sweepOutput = "sweep.csv";
+    // Configurations simulated as one ensemble.
+    int sweepBatch = 8;
+    // Concurrent jobs per device, so one can compute while another reads back.
+    int sweepJobsPerDevice = 2;
+
+    // Devices to split a single board into strips over, headless for sweepGenerations generations: gpu, all or
+    // cpu:N, see StripRunner. Empty opens the window instead.
+    std::string strips;
+
+    // Directory of the program binary cache, empty disables it. Not set means ProgramCache::defaultDirectory().
+    std::optional<std::string> programCache;
+
+    // Whether the work-group sizes are tuned per device (see LaunchTuner), and whether cached results are measured
+    // again.
+    bool tune = true;
+    bool retune = false;
+
+    // Sparse board passes over active tiles only, see Simulation::setSparse().
+    bool sparse = false;
+
+    // Sensor distance from which actors sense in the trail pyramid, rebuilt every pyramidInterval generations, see
+    // Simulation::setPyramid(). 0 disables it.
+    int pyramidFrom = 0;
+    int pyramidInterval = 4;
+
+    // Deterministic mode, see Simulation::setDeterministic(). Without a seed it starts from seed 1, otherwise from
+    // the clock.
+    bool deterministic = false;
+    std::optional<std::uint64_t> seed;
+    // Generations to run headless before printing the state checksum and exiting, 0 opens the window instead.
+    int checksumGenerations = 0;
+
+    // Directory of the keyframes of a deterministic run, written every keyframeInterval generations within
+    // keyframeBudget MiB (see KeyframeStore). Empty disables them.
+    std::string keyframes;
+    int keyframeInterval = 10000;
+    int keyframeBudget = 4096;
+    // Generation to start at, reached from the keyframes.
+    std::optional<int> seek;
+
+    // Checkpoint file written every checkpointInterval generations (0 disables) and with the S key.
+    std::string checkpoint = "slime.checkpoint";
+    int checkpointInterval = 0;
+    // Checkpoint to continue from instead of starting a new simulation.
+    std::string restore;
+
+    // The P key writes the displayed member to <snapshotPrefix>-<generation>.snapshot, see Snapshot.h.
+    std::string snapshotPrefix = "slime";
+
+    // Frame capture started right away, toggled with the C key. *.y4m is a video, anything else a PPM sequence.
+    std::string capture;
+
+    // Telemetry file, in the window and in sweeps, written every telemetryInterval generations. Empty disables it.
+    std::string telemetry;
+    int telemetryInterval = 100;
+
+    // Seconds between reports of the per-kernel device times, 0 disables profiling. Sweeps report once at the end.
+    double profileInterval = 0;
+
+    // Reports achieved bandwidth and arithmetic rate of the kernels against measured device peaks with the profile.
+    bool roofline = false;
+    // Trace Event JSON file with host spans and device intervals, see Tracer. Empty disables tracing.
+    std::string trace;
+
+    // Directory whose kernel sources are reloaded on change, empty disables reloading.
+    std::string watchKernels;
+
+    bool help = false;
+
+    // Throws Exception on unknown options or malformed values.
+    [[nodiscard]] static Settings parse(int argc, char **argv);
+    [[nodiscard]] static std::string usage();
+
+private:
+    void set(const std::string &name, const std::string &value);
+};
@@ -0,0 +1,685 @@
+#include "Simulation.h"
+
+#include "Board.h"
+#include "Exception.h"
+#include "Hash.h"
+#include "Profiler.h"
+#include "Statistics.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+namespace
+{
+
+inline unsigned divup(unsigned a, unsigned b)
+{
+    return (a + b - 1) / b;
+}
+
+// Actor launches are split into chunks of at most this many work-items over all members, which keeps global sizes
+// well within 32 bits and single launches short enough for display watchdogs.
+const int maxActorsPerLaunch = 1 << 22;
+
+// Chunk of `indices` actor indices for `members` members, a multiple of `local`.
+int actorChunk(int local, int members)
+{
+    return std::max(local, maxActorsPerLaunch / std::max(members, 1) / local * local);
+}
+
+}
+
+SpawnRegion SpawnRegion::centered(SpawnShape shape, int2 boardSize)
+{
+    const float2 center{boardSize.x / 2.f, boardSize.y / 2.f};
+    if (shape == SPAWN_DISC)
+        return {shape, center, {boardSize.y / 2.1f, boardSize.y / 2.1f}};
+    return {shape, center, {boardSize.x / 2.1f, boardSize.y / 2.1f}};
+}
+
+Simulation::Simulation(const cl::Context &context, const cl::Device &device, const cl::CommandQueue &queue,
+                       const cl::Program &boardProgram, const cl::Program &actorProgram) :
+    m_context(context),
+    m_device(device),
+    m_queue(queue),
+    m_boardKernel(boardProgram, "board"),
+    m_initBoardKernel(boardProgram, "initBoard"),
+    m_colorizeKernel(boardProgram, "colorize"),
+    m_actorKernel(actorProgram, "actor"),
+    m_initActorsKernel(actorProgram, "initActors"),
+    m_reduceCellsKernel(boardProgram, "reduceCells"),
+    m_reduceActorsKernel(actorProgram, "reduceActors"),
+    m_finishTelemetryKernel(boardProgram, "finishTelemetry"),
+    m_diffuseKernel(boardProgram, "diffuse"),
+    m_commitTrailKernel(boardProgram, "commitTrail"),
+    m_compactTilesKernel(boardProgram, "compactTiles"),
+    m_finishTilesKernel(boardProgram, "finishTiles"),
+    m_buildPyramidKernel(boardProgram, "buildPyramid"),
+    m_sequence(device, queue)
+{
+    cl_int errCode;
+    m_generationCounter = cl::Buffer(m_context, CL_MEM_READ_WRITE, sizeof(int), nullptr, &errCode);
+    if (errCode != CL_SUCCESS)
+        throw Exception(fmt::format("Failed to create generation counter: {}", errCode));
+}
+
+void Simulation::reset(int2 boardSize, const std::vector<Parameters> &members, std::uint64_t seed,
+                       const SpawnRegion &spawn)
+{
+    resetRows(boardSize, 0, boardSize.y, members, seed, spawn);
+}
+
+void Simulation::resetRows(int2 boardSize, int top, int height, const std::vector<Parameters> &members,
+                           std::uint64_t seed, const SpawnRegion &spawn)
+{
+    if (top < 0 || top + boardSize.y > height)
+        throw Exception(fmt::format("Rows {} to {} are not on a board of {} rows", top, top + boardSize.y, height));
+    allocate(boardSize, members);
+
+    const cl::NDRange local(16, 16, 1);
+    const cl::NDRange global(local[0] * divup(m_boardSize.x, local[0]), local[1] * divup(m_boardSize.y, local[1]),
+                             m_members);
+    m_initBoardKernel.setArg(0, m_cells);
+    m_initBoardKernel.setArg(1, m_boardSize);
+    m_initBoardKernel.setArg(2, top);
+    m_initBoardKernel.setArg(3, height);
+    m_queue.enqueueNDRangeKernel(m_initBoardKernel, cl::NullRange, global, local);
+
+    resetActors(members, seed, spawn);
+}
+
+void Simulation::reset(const Board &board, const std::vector<Parameters> &members, std::uint64_t seed,
+                       const SpawnRegion &spawn)
+{
+    allocate({board.width(), board.height()}, members);
+    for (int m = 0; m < m_members; ++m)
+        m_queue.enqueueWriteBuffer(m_cells, false, m * board.dataSize(), board.dataSize(), board.cells().data());
+    resetActors(members, seed, spawn);
+}
+
+void Simulation::restore(int2 boardSize, const std::vector<Parameters> &members, int generation, const void *cells,
+                         const void *actors)
+{
+    allocate(boardSize, members);
+    const std::size_t cellsSize = static_cast<std::size_t>(m_boardSize.x) * m_boardSize.y * m_members * sizeof(Cell);
+    const std::size_t actorsSize = static_cast<std::size_t>(m_actorsPerMember) * m_members * sizeof(Actor);
+    m_queue.enqueueWriteBuffer(m_cells, false, 0, cellsSize, cells);
+    if (actorsSize > 0)
+        m_queue.enqueueWriteBuffer(m_actors, false, 0, actorsSize, actors);
+    m_queue.enqueueWriteBuffer(m_parameters, false, 0, sizeof(Parameters) * m_members, members.data());
+    m_generation = generation;
+    m_queue.enqueueWriteBuffer(m_generationCounter, false, 0, sizeof(m_generation), &m_generation);
+    m_queue.finish();
+
+    if (m_displayMember >= m_members)
+        m_displayMember = -1;
+    m_sequence.clear();
+}
+
+void Simulation::allocate(int2 boardSize, const std::vector<Parameters> &members)
+{
+    if (members.empty())
+        throw Exception("A simulation needs at least one ensemble member");
+
+    m_parameterValues = members;
+    m_boardSize = boardSize;
+    m_members = members.size();
+    m_actorsPerMember = 0;
+    for (const Parameters &p : members)
+        m_actorsPerMember = std::max(m_actorsPerMember, p.actorCount);
+
+    const std::size_t cellCount = static_cast<std::size_t>(m_boardSize.x) * m_boardSize.y * m_members;
+    ensureBuffer(m_cells, m_cellsCapacity, cellCount * sizeof(Cell), CL_MEM_READ_WRITE);
+    ensureBuffer(m_actors, m_actorsCapacity,
+                 std::max<std::size_t>(sizeof(Actor) * m_actorsPerMember * m_members, 1), CL_MEM_READ_WRITE);
+    ensureBuffer(m_parameters, m_parametersCapacity, sizeof(Parameters) * m_members, CL_MEM_READ_ONLY);
+    if (m_deterministic)
+        allocateDeterministic();
+    if (m_sparse)
+        allocateSparse();
+    if (m_pyramidFrom > 0)
+        allocatePyramid();
+}
+
+void Simulation::allocatePyramid()
+{
+    std::size_t floats = 0;
+    for (int level = 1; level <= PYRAMID_LEVELS; ++level)
+        floats += static_cast<std::size_t>(divup(m_boardSize.x, 1u << level)) * divup(m_boardSize.y, 1u << level);
+    ensureBuffer(m_pyramid, m_pyramidCapacity, floats * m_members * sizeof(float), CL_MEM_READ_WRITE);
+    // Built before the next step, whatever the generation.
+    m_pyramidStale = true;
+}
+
+void Simulation::allocateDeterministic()
+{
+    const std::size_t cellCount = static_cast<std::size_t>(m_boardSize.x) * m_boardSize.y * m_members;
+    ensureBuffer(m_deposits, m_depositsCapacity, cellCount * sizeof(cl_int), CL_MEM_READ_WRITE);
+    ensureBuffer(m_nextTrail, m_nextTrailCapacity, cellCount * sizeof(float), CL_MEM_READ_WRITE);
+    // commitTrail() clears the deposits it took, so they only need clearing here.
+    m_queue.enqueueFillBuffer(m_deposits, cl_int(0), 0, cellCount * sizeof(cl_int));
+}
+
+void Simulation::allocateSparse()
+{
+    const std::size_t tiles = static_cast<std::size_t>(tileGrid().x) * tileGrid().y * m_members;
+    ensureBuffer(m_tileFlags, m_tileFlagsCapacity, tiles * sizeof(cl_int), CL_MEM_READ_WRITE);
+    ensureBuffer(m_nextTileFlags, m_nextTileFlagsCapacity, tiles * sizeof(cl_int), CL_MEM_READ_WRITE);
+    ensureBuffer(m_tiles, m_tilesCapacity, tiles * sizeof(cl_int), CL_MEM_READ_WRITE);
+    ensureBuffer(m_tileCounts, m_tileCountsCapacity, m_members * sizeof(cl_int), CL_MEM_READ_WRITE);
+    // All tiles start active, so whatever trail the board already has is blurred once and kept active from then on.
+    m_queue.enqueueFillBuffer(m_tileFlags, cl_int(1), 0, tiles * sizeof(cl_int));
+    m_queue.enqueueFillBuffer(m_nextTileFlags, cl_int(0), 0, tiles * sizeof(cl_int));
+    m_queue.enqueueFillBuffer(m_tileCounts, cl_int(0), 0, m_members * sizeof(cl_int));
+}
+
+int2 Simulation::tileGrid() const
+{
+    return {static_cast<int>(divup(m_boardSize.x, TILE_SIZE)), static_cast<int>(divup(m_boardSize.y, TILE_SIZE))};
+}
+
+void Simulation::resetActors(const std::vector<Parameters> &members, std::uint64_t seed, const SpawnRegion &spawn)
+{
+    m_queue.enqueueWriteBuffer(m_parameters, false, 0, sizeof(Parameters) * m_members, members.data());
+    m_generation = 0;
+    m_queue.enqueueWriteBuffer(m_generationCounter, false, 0, sizeof(m_generation), &m_generation);
+
+    spawnActors(0, m_members, 0, seed, spawn);
+    // The writes above read host memory that goes out of scope.
+    m_queue.finish();
+
+    if (m_displayMember >= m_members)
+        m_displayMember = -1;
+    m_sequence.clear();
+}
+
+void Simulation::spawnActors(int firstMember, int memberCount, int firstActor, std::uint64_t seed,
+                             const SpawnRegion &spawn)
+{
+    m_initActorsKernel.setArg(0, m_actors);
+    m_initActorsKernel.setArg(1, m_actorsPerMember);
+    m_initActorsKernel.setArg(2, m_parameters);
+    m_initActorsKernel.setArg(3, m_cells);
+    m_initActorsKernel.setArg(4, m_boardSize);
+    m_initActorsKernel.setArg(5, static_cast<cl_int>(spawn.shape));
+    m_initActorsKernel.setArg(6, spawn.center);
+    m_initActorsKernel.setArg(7, spawn.extent);
+    m_initActorsKernel.setArg(8, static_cast<cl_ulong>(seed));
+
+    const cl::NDRange local(16, 1);
+    const int chunk = actorChunk(local[0], memberCount);
+    for (int first = firstActor; first < m_actorsPerMember; first += chunk)
+    {
+        const cl::NDRange global(local[0] * divup(std::min(chunk, m_actorsPerMember - first), local[0]), memberCount);
+        m_queue.enqueueNDRangeKernel(m_initActorsKernel, cl::NDRange(first, firstMember), global, local);
+    }
+}
+
+void Simulation::setActorCounts(const std::vector<int> &counts, std::uint64_t seed, const SpawnRegion &spawn)
+{
+    if (static_cast<int>(counts.size()) != m_members)
+        throw Exception(fmt::format("{} actor counts given for {} members", counts.size(), m_members));
+    if (std::any_of(counts.begin(), counts.end(), [](int count) { return count < 0; }))
+        throw Exception("Actor counts must not be negative");
+
+    // Every member has a block of as many slots as the largest population. A new size moves the blocks into a new
+    // buffer on the device; otherwise only the actors that are spawned or killed are touched.
+    const int previousSlots = m_actorsPerMember;
+    const int slots = *std::max_element(counts.begin(), counts.end());
+    if (slots != previousSlots)
+    {
+        const std::size_t size = std::max<std::size_t>(sizeof(Actor) * slots * m_members, 1);
+        cl::Buffer actors(m_context, CL_MEM_READ_WRITE, size);
+        const std::size_t kept = sizeof(Actor) * std::min(slots, previousSlots);
+        if (kept > 0)
+            for (int m = 0; m < m_members; ++m)
+                m_queue.enqueueCopyBuffer(m_actors, actors, sizeof(Actor) * previousSlots * m,
+                                          sizeof(Actor) * slots * m, kept);
+        m_actors = actors;
+        m_actorsCapacity = size;
+        m_actorsPerMember = slots;
+    }
+
+    std::vector<int> previous(m_members);
+    for (int m = 0; m < m_members; ++m)
+    {
+        previous[m] = m_parameterValues[m].actorCount;
+        m_parameterValues[m].actorCount = counts[m];
+    }
+    m_queue.enqueueWriteBuffer(m_parameters, false, 0, sizeof(Parameters) * m_members, m_parameterValues.data());
+
+    // initActors() spawns the slots below the new count and marks the others dead. Slots that were added above the
+    // previous block hold nothing yet and need the same.
+    for (int m = 0; m < m_members; ++m)
+        if (previous[m] != counts[m] || slots > previousSlots)
+            spawnActors(m, 1, std::min(previous[m], counts[m]), seed, spawn);
+    m_sequence.clear();
+}
+
+void Simulation::setPrograms(const cl::Program &boardProgram, const cl::Program &actorProgram)
+{
+    cl::Kernel boardKernel;
+    cl::Kernel initBoardKernel;
+    cl::Kernel colorizeKernel;
+    cl::Kernel actorKernel;
+    cl::Kernel initActorsKernel;
+    cl::Kernel reduceCellsKernel;
+    cl::Kernel reduceActorsKernel;
+    cl::Kernel finishTelemetryKernel;
+    cl::Kernel diffuseKernel;
+    cl::Kernel commitTrailKernel;
+    cl::Kernel compactTilesKernel;
+    cl::Kernel finishTilesKernel;
+    cl::Kernel buildPyramidKernel;
+    try
+    {
+        boardKernel = cl::Kernel(boardProgram, "board");
+        initBoardKernel = cl::Kernel(boardProgram, "initBoard");
+        colorizeKernel = cl::Kernel(boardProgram, "colorize");
+        actorKernel = cl::Kernel(actorProgram, "actor");
+        initActorsKernel = cl::Kernel(actorProgram, "initActors");
+        reduceCellsKernel = cl::Kernel(boardProgram, "reduceCells");
+        reduceActorsKernel = cl::Kernel(actorProgram, "reduceActors");
+        finishTelemetryKernel = cl::Kernel(boardProgram, "finishTelemetry");
+        diffuseKernel = cl::Kernel(boardProgram, "diffuse");
+        commitTrailKernel = cl::Kernel(boardProgram, "commitTrail");
+        compactTilesKernel = cl::Kernel(boardProgram, "compactTiles");
+        finishTilesKernel = cl::Kernel(boardProgram, "finishTiles");
+        buildPyramidKernel = cl::Kernel(boardProgram, "buildPyramid");
+    }
+    catch (const cl::Error &error)
+    {
+        throw Exception(fmt::format("Failed to create kernels: {}({})", error.what(), error.err()));
+    }
+    m_boardKernel = boardKernel;
+    m_initBoardKernel = initBoardKernel;
+    m_colorizeKernel = colorizeKernel;
+    m_actorKernel = actorKernel;
+    m_initActorsKernel = initActorsKernel;
+    m_reduceCellsKernel = reduceCellsKernel;
+    m_reduceActorsKernel = reduceActorsKernel;
+    m_finishTelemetryKernel = finishTelemetryKernel;
+    m_diffuseKernel = diffuseKernel;
+    m_commitTrailKernel = commitTrailKernel;
+    m_compactTilesKernel = compactTilesKernel;
+    m_finishTilesKernel = finishTilesKernel;
+    m_buildPyramidKernel = buildPyramidKernel;
+    m_sequence.clear();
+}
+
+void Simulation::setOutput(const cl::Image &image, int displayMember)
+{
+    m_output = image;
+    m_outputSize = {static_cast<int>(image.getImageInfo<CL_IMAGE_WIDTH>()),
+                    static_cast<int>(image.getImageInfo<CL_IMAGE_HEIGHT>())};
+    setDisplayMember(displayMember);
+}
+
+void Simulation::setDisplayMember(int displayMember)
+{
+    m_displayMember = displayMember;
+}
+
+void Simulation::setView(float2 origin, float scale)
+{
+    m_viewOrigin = origin;
+    m_viewScale = scale;
+}
+
+void Simulation::setLaunchShape(const LaunchShape &shape)
+{
+    if (shape.actorLocal < 1 || shape.boardLocal.x < 1 || shape.boardLocal.y < 1)
+        throw Exception(fmt::format("Invalid work-group sizes {} and {}x{}", shape.actorLocal, shape.boardLocal.x,
+                                    shape.boardLocal.y));
+    m_launchShape = shape;
+    m_sequence.clear();
+}
+
+void Simulation::setDeterministic(bool deterministic)
+{
+    m_deterministic = deterministic;
+    if (m_deterministic && m_members > 0)
+        allocateDeterministic();
+    m_sequence.clear();
+}
+
+void Simulation::setSparse(bool sparse)
+{
+    m_sparse = sparse;
+    if (m_sparse && m_members > 0)
+        allocateSparse();
+    m_sequence.clear();
+}
+
+void Simulation::setPyramid(int from, int interval)
+{
+    if (from < 0 || interval < 1)
+        throw Exception(fmt::format("Invalid pyramid distance {} or interval {}", from, interval));
+    m_pyramidFrom = from;
+    m_pyramidInterval = interval;
+    if (m_pyramidFrom > 0 && m_members > 0)
+        allocatePyramid();
+    m_sequence.clear();
+}
+
+void Simulation::setProfiler(Profiler *profiler)
+{
+    m_profiler = profiler;
+}
+
+void Simulation::step(int generations)
+{
+    if (generations <= 0)
+        return;
+
+    if (m_sequence.repetitions() != generations)
+    {
+        const cl::NDRange localActor(m_launchShape.actorLocal, 1);
+        m_actorKernel.setArg(0, m_cells);
+        m_actorKernel.setArg(1, m_boardSize);
+        m_actorKernel.setArg(2, m_actors);
+        m_actorKernel.setArg(3, m_actorsPerMember);
+        m_actorKernel.setArg(4, m_generationCounter);
+        m_actorKernel.setArg(5, m_parameters);
+        m_actorKernel.setArg(6, m_deterministic ? m_deposits : cl::Buffer());
+        m_actorKernel.setArg(7, static_cast<cl_int>(m_deterministic));
+        m_actorKernel.setArg(8, m_sparse ? m_tileFlags : cl::Buffer());
+        m_actorKernel.setArg(9, m_pyramidFrom > 0 ? m_pyramid : cl::Buffer());
+        m_actorKernel.setArg(10, m_pyramidFrom);
+
+        // Sparse board passes run a work-group per slot of the tile lists, most of which return right away: without
+        // indirect launches the host would have to wait for the counts.
+        const cl::Buffer tiles = m_sparse ? m_tiles : cl::Buffer();
+        const cl::Buffer tileCounts = m_sparse ? m_tileCounts : cl::Buffer();
+        const cl::Buffer nextTileFlags = m_sparse ? m_nextTileFlags : cl::Buffer();
+        const int2 tileGrid = this->tileGrid();
+        const int2 boardLocal = m_sparse ? int2{TILE_SIZE, TILE_SIZE} : m_launchShape.boardLocal;
+        const cl::NDRange localBoard(boardLocal.x, boardLocal.y, 1);
+        const cl::NDRange globalBoard = m_sparse
+                ? cl::NDRange(TILE_SIZE, TILE_SIZE * tileGrid.x * tileGrid.y, m_members)
+                : cl::NDRange(localBoard[0] * divup(m_boardSize.x, localBoard[0]),
+                              localBoard[1] * divup(m_boardSize.y, localBoard[1]), m_members);
+        const cl::NDRange globalTiles(tileGrid.x, tileGrid.y, m_members);
+        const double tileCount = static_cast<double>(tileGrid.x) * tileGrid.y * m_members;
+        const double cells = static_cast<double>(m_boardSize.x) * m_boardSize.y * m_members;
+        // Sparse board passes are credited with every cell, so their throughput is an effective one.
+        const char *boardUnit = m_sparse ? "effective cells" : "cells";
+        std::vector<FrameSequence::Launch> step;
+        m_stepLaunches.clear();
+
+        // The pyramid kernel returns right away in the generations between rebuilds.
+        const cl::NDRange globalPyramid(divup(m_boardSize.x, 2), divup(m_boardSize.y, 2), m_members);
+        if (m_pyramidFrom > 0)
+        {
+            m_buildPyramidKernel.setArg(0, m_cells);
+            m_buildPyramidKernel.setArg(1, m_boardSize);
+            m_buildPyramidKernel.setArg(2, m_generationCounter);
+            m_buildPyramidKernel.setArg(3, m_pyramidInterval);
+            m_buildPyramidKernel.setArg(4, m_pyramid);
+            step.push_back({m_buildPyramidKernel, globalPyramid, cl::NullRange});
+            m_stepLaunches.push_back({"buildPyramid", cells / 4, "cells"});
+        }
+
+        // Large populations take several launches, see maxActorsPerLaunch.
+        const int chunk = actorChunk(localActor[0], m_members);
+        for (int first = 0; first < std::max(m_actorsPerMember, 1); first += chunk)
+        {
+            const int count = std::min(chunk, std::max(m_actorsPerMember, 1) - first);
+            const cl::NDRange globalActor(localActor[0] * divup(count, localActor[0]), m_members);
+            step.push_back({m_actorKernel, globalActor, localActor, cl::NDRange(first, 0)});
+            m_stepLaunches.push_back({"actor", static_cast<double>(count) * m_members, "actors"});
+        }
+        if (m_sparse)
+        {
+            m_compactTilesKernel.setArg(0, m_boardSize);
+            m_compactTilesKernel.setArg(1, m_tileFlags);
+            m_compactTilesKernel.setArg(2, m_tiles);
+            m_compactTilesKernel.setArg(3, m_tileCounts);
+            step.push_back({m_compactTilesKernel, globalTiles, cl::NullRange});
+            m_stepLaunches.push_back({"compactTiles", tileCount, "tiles"});
+        }
+        if (m_deterministic)
+        {
+            m_diffuseKernel.setArg(0, m_cells);
+            m_diffuseKernel.setArg(1, m_boardSize);
+            m_diffuseKernel.setArg(2, m_deposits);
+            m_diffuseKernel.setArg(3, m_parameters);
+            m_diffuseKernel.setArg(4, m_nextTrail);
+            m_diffuseKernel.setArg(5, tiles);
+            m_diffuseKernel.setArg(6, tileCounts);
+            m_commitTrailKernel.setArg(0, m_cells);
+            m_commitTrailKernel.setArg(1, m_boardSize);
+            m_commitTrailKernel.setArg(2, m_nextTrail);
+            m_commitTrailKernel.setArg(3, m_deposits);
+            m_commitTrailKernel.setArg(4, m_generationCounter);
+            m_commitTrailKernel.setArg(5, tiles);
+            m_commitTrailKernel.setArg(6, tileCounts);
+            m_commitTrailKernel.setArg(7, nextTileFlags);
+            step.push_back({m_diffuseKernel, globalBoard, localBoard});
+            step.push_back({m_commitTrailKernel, globalBoard, localBoard});
+            m_stepLaunches.push_back({"diffuse", cells, boardUnit});
+            m_stepLaunches.push_back({"commitTrail", cells, boardUnit});
+        }
+        else
+        {
+            m_boardKernel.setArg(0, m_cells);
+            m_boardKernel.setArg(1, m_boardSize);
+            m_boardKernel.setArg(2, m_generationCounter);
+            m_boardKernel.setArg(3, m_parameters);
+            m_boardKernel.setArg(4, tiles);
+            m_boardKernel.setArg(5, tileCounts);
+            m_boardKernel.setArg(6, nextTileFlags);
+            step.push_back({m_boardKernel, globalBoard, localBoard});
+            m_stepLaunches.push_back({"board", cells, boardUnit});
+        }
+        if (m_sparse)
+        {
+            m_finishTilesKernel.setArg(0, m_boardSize);
+            m_finishTilesKernel.setArg(1, m_tileFlags);
+            m_finishTilesKernel.setArg(2, m_nextTileFlags);
+            m_finishTilesKernel.setArg(3, m_tileCounts);
+            step.push_back({m_finishTilesKernel, globalTiles, cl::NullRange});
+            m_stepLaunches.push_back({"finishTiles", tileCount, "tiles"});
+        }
+
+        // The generation counter lives on the device, so all steps of a frame are identical.
+        m_sequence.record(step, generations);
+    }
+
+    if (m_pyramidFrom > 0 && m_pyramidStale)
+    {
+        // Sets the interval back, the host enqueue list replays the kernel with its current arguments.
+        m_buildPyramidKernel.setArg(3, 1);
+        m_queue.enqueueNDRangeKernel(m_buildPyramidKernel, cl::NullRange,
+                                     cl::NDRange(divup(m_boardSize.x, 2), divup(m_boardSize.y, 2), m_members));
+        m_buildPyramidKernel.setArg(3, m_pyramidInterval);
+        m_pyramidStale = false;
+    }
+
+    if (m_profiler)
+    {
+        // The launches of a step, see above, repeated for every generation.
+        std::vector<cl::Event> launches;
+        m_sequence.replay(nullptr, nullptr, &launches);
+        for (std::size_t i = 0; i < launches.size(); ++i)
+        {
+            const StepLaunch &launch = m_stepLaunches[i % m_stepLaunches.size()];
+            m_profiler->add(launch.name, launches[i], launch.items, launch.unit);
+        }
+    }
+    else
+        m_sequence.replay();
+    m_generation += generations;
+}
+
+void Simulation::draw()
+{
+    if (!m_output() || m_displayMember < 0 || m_displayMember >= m_members)
+        return;
+
+    const cl::NDRange local(16, 16);
+    const cl::NDRange global(local[0] * divup(m_outputSize.x, local[0]), local[1] * divup(m_outputSize.y, local[1]));
+    m_colorizeKernel.setArg(0, m_output);
+    m_colorizeKernel.setArg(1, m_cells);
+    m_colorizeKernel.setArg(2, m_boardSize);
+    m_colorizeKernel.setArg(3, m_displayMember);
+    m_colorizeKernel.setArg(4, m_viewOrigin);
+    m_colorizeKernel.setArg(5, m_viewScale);
+    cl::Event event;
+    m_queue.enqueueNDRangeKernel(m_colorizeKernel, cl::NullRange, global, local, nullptr,
+                                 m_profiler ? &event : nullptr);
+    if (m_profiler)
+        m_profiler->add("colorize", event, static_cast<double>(m_outputSize.x) * m_outputSize.y, "pixels");
+}
+
+void Simulation::measure(std::vector<Telemetry> &telemetry, cl::Event &done)
+{
+    ensureBuffer(m_telemetryPartials, m_telemetryPartialsCapacity,
+                 sizeof(TelemetryPartial) * TELEMETRY_GROUPS * m_members, CL_MEM_READ_WRITE);
+    ensureBuffer(m_telemetry, m_telemetryCapacity, sizeof(Telemetry) * m_members, CL_MEM_READ_WRITE);
+
+    const cl::NDRange local(TELEMETRY_GROUP_SIZE, 1);
+    const cl::NDRange global(TELEMETRY_GROUP_SIZE * TELEMETRY_GROUPS, m_members);
+    m_reduceCellsKernel.setArg(0, m_cells);
+    m_reduceCellsKernel.setArg(1, m_boardSize);
+    m_reduceCellsKernel.setArg(2, Statistics::coverageThreshold);
+    m_reduceCellsKernel.setArg(3, m_telemetryPartials);
+    m_queue.enqueueNDRangeKernel(m_reduceCellsKernel, cl::NullRange, global, local);
+
+    m_reduceActorsKernel.setArg(0, m_actors);
+    m_reduceActorsKernel.setArg(1, m_actorsPerMember);
+    m_reduceActorsKernel.setArg(2, m_telemetryPartials);
+    m_queue.enqueueNDRangeKernel(m_reduceActorsKernel, cl::NullRange, global, local);
+
+    m_finishTelemetryKernel.setArg(0, m_telemetryPartials);
+    m_finishTelemetryKernel.setArg(1, m_generationCounter);
+    m_finishTelemetryKernel.setArg(2, m_telemetry);
+    m_finishTelemetryKernel.setArg(3, m_members);
+    m_queue.enqueueNDRangeKernel(m_finishTelemetryKernel, cl::NullRange, cl::NDRange(m_members));
+
+    telemetry.resize(m_members);
+    m_queue.enqueueReadBuffer(m_telemetry, false, 0, sizeof(Telemetry) * m_members, telemetry.data(), nullptr,
+                              &done);
+}
+
+void Simulation::readCells(int member, std::vector<Cell> &cells) const
+{
+    const std::size_t count = static_cast<std::size_t>(m_boardSize.x) * m_boardSize.y;
+    cells.resize(count);
+    m_queue.enqueueReadBuffer(m_cells, true, member * count * sizeof(Cell), count * sizeof(Cell), cells.data());
+}
+
+void Simulation::readActors(int member, std::vector<Actor> &actors) const
+{
+    actors.assign(m_actorsPerMember, Actor{{0, 0}, 0, 0, 0, false});
+    if (m_actorsPerMember > 0)
+        m_queue.enqueueReadBuffer(m_actors, true, std::size_t(member) * m_actorsPerMember * sizeof(Actor),
+                                  m_actorsPerMember * sizeof(Actor), actors.data());
+}
+
+const cl::CommandQueue &Simulation::queue() const
+{
+    return m_queue;
+}
+
+const cl::Buffer &Simulation::cells() const
+{
+    return m_cells;
+}
+
+const cl::Buffer &Simulation::actors() const
+{
+    return m_actors;
+}
+
+const std::vector<Parameters> &Simulation::parameters() const
+{
+    return m_parameterValues;
+}
+
+int Simulation::generation() const
+{
+    return m_generation;
+}
+
+int Simulation::members() const
+{
+    return m_members;
+}
+
+int2 Simulation::boardSize() const
+{
+    return m_boardSize;
+}
+
+int Simulation::actorsPerMember() const
+{
+    return m_actorsPerMember;
+}
+
+int Simulation::displayMember() const
+{
+    return m_displayMember;
+}
+
+bool Simulation::deterministic() const
+{
+    return m_deterministic;
+}
+
+std::uint64_t Simulation::checksum() const
+{
+    // Field by field, the padding of Cell and Actor is not part of the state.
+    Hash hash;
+    std::vector<Cell> cells;
+    std::vector<Actor> actors;
+    for (int m = 0; m < m_members; ++m)
+    {
+        readCells(m, cells);
+        for (const Cell &c : cells)
+        {
+            const unsigned char solid = c.solid;
+            hash.add(&solid, sizeof(solid)).add(&c.trail, sizeof(c.trail));
+        }
+        readActors(m, actors);
+        for (const Actor &a : actors)
+        {
+            const unsigned char alive = a.alive;
+            hash.add(&a.pos, sizeof(a.pos)).add(&a.speed, sizeof(a.speed)).add(&a.targetSpeed, sizeof(a.targetSpeed))
+                    .add(&a.direction, sizeof(a.direction)).add(&alive, sizeof(alive));
+        }
+    }
+    hash.add(&m_generation, sizeof(m_generation));
+    return hash.value();
+}
+
+bool Simulation::sparse() const
+{
+    return m_sparse;
+}
+
+int Simulation::pyramidFrom() const
+{
+    return m_pyramidFrom;
+}
+
+const LaunchShape &Simulation::launchShape() const
+{
+    return m_launchShape;
+}
+
+void Simulation::ensureBuffer(cl::Buffer &buffer, std::size_t &capacity, std::size_t size, cl_mem_flags flags)
+{
+    if (size <= capacity)
+        return;
+    const cl_ulong maxAllocation = m_device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+    if (size > maxAllocation)
+        throw Exception(fmt::format("{} bytes exceed the device's largest allocation of {} bytes, use a smaller board"
+                                    " or fewer members", size, maxAllocation));
+    cl_int errCode;
+    buffer = cl::Buffer(m_context, flags, size, nullptr, &errCode);
+    if (errCode != CL_SUCCESS)
+        throw Exception(fmt::format("Failed to allocate {} bytes of device memory: {}", size, errCode));
+    capacity = size;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "FrameSequence.h"
+#include "assets/Actor.h"
+#include "assets/Cell.h"
+#include "assets/Parameters.h"
+#include "assets/Pyramid.h"
+#include "assets/Spawn.h"
+#include "assets/Telemetry.h"
+#include "assets/Tiles.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Board;
+class Profiler;
+
+// Region the actors of a fresh population are spawned in.
+struct SpawnRegion
+{
+    SpawnShape shape;
+    float2 center;
+    float2 extent;
+
+    // `shape` around the center of a board of `boardSize`, keeping clear of the border.
+    [[nodiscard]] static SpawnRegion centered(SpawnShape shape, int2 boardSize);
+};
+
+// Work-group sizes of the per generation kernels. The defaults suit most GPUs; the best shape differs a lot between
+// devices and runtimes.
+struct LaunchShape
+{
+    int actorLocal = 16;
+    int2 boardLocal{16, 16};
+};
+
+// Device state of one (ensemble) simulation: the board and actor buffers, the kernels and the recorded frame. Does
+// not depend on OpenGL, the caller hands in the image to draw into and takes care of acquiring it.
+class Simulation
+{
+public:
+    Simulation(const cl::Context &context, const cl::Device &device, const cl::CommandQueue &queue,
+               const cl::Program &boardProgram, const cl::Program &actorProgram);
+
+    // Starts over with an empty bordered board for every member and a fresh actor population in `spawn`, both
+    // generated on the device. The actors only depend on `seed`. Buffers are reused if large enough.
+    void reset(int2 boardSize, const std::vector<Parameters> &members, std::uint64_t seed, const SpawnRegion &spawn);
+    // Same, but the board is rows [top, top + boardSize.y) of the default board of `height` rows, e.g. one strip of it,
+    // with the walls where they are on the whole board. Throws Exception unless the rows are on it.
+    void resetRows(int2 boardSize, int top, int height, const std::vector<Parameters> &members, std::uint64_t seed,
+                   const SpawnRegion &spawn);
+    // Same, but every member starts from `board`, e.g. a custom map, which is uploaded.
+    void reset(const Board &board, const std::vector<Parameters> &members, std::uint64_t seed,
+               const SpawnRegion &spawn);
+
+    // Continues from a saved state: `cells` and `actors` hold all members back to back, as the device buffers do.
+    // The uploads read straight from the given memory and are complete when this returns.
+    void restore(int2 boardSize, const std::vector<Parameters> &members, int generation, const void *cells,
+                 const void *actors);
+
+    // Replaces the kernels, e.g. after they were rebuilt. Board and actor state are kept, the next step records the
+    // frame with the new kernels. Throws Exception if a program lacks its kernel, leaving the old ones in place.
+    void setPrograms(const cl::Program &boardProgram, const cl::Program &actorProgram);
+
+    // Image draw() colorizes `displayMember` into. Without an output nothing is drawn.
+    void setOutput(const cl::Image &image, int displayMember);
+    void setDisplayMember(int displayMember);
+    // Output pixel (x, y) shows the board at origin + (x + .5, y + .5) * scale, see colorize() in Board.cl.
+    void setView(float2 origin, float scale);
+
+    // Spawns or kills actors so member m has counts[m], e.g. to scale the population while running. Surviving actors
+    // carry on; new ones are spawned in `spawn` and only depend on `seed`, their member and their slot, as in reset().
+    // Only the changed slots are written unless the largest count changes, which moves the actors into a buffer of
+    // the new size on the device. Throws Exception unless there is a count of 0 or more for every member.
+    void setActorCounts(const std::vector<int> &counts, std::uint64_t seed, const SpawnRegion &spawn);
+
+    // In deterministic mode the same seed gives a bit identical state on a given device: actors deposit trail in fixed
+    // point with integer atomics instead of racing on the board, and diffusion writes into a second buffer instead of
+    // blurring in place. Costs a buffer of an int and a float per cell and an extra launch per generation.
+    void setDeterministic(bool deterministic);
+
+    // In sparse mode the board passes only blur active tiles (see Tiles.h): tiles with actors or with a trail above
+    // TILE_ACTIVE_TRAIL, and their neighbours. Trails below it stay as they are instead of fading out. Saves most of
+    // the board pass early in a run and on sparse maps, at the cost of two small passes over the tiles. Every reset or
+    // restore starts with all tiles active, so a restored run does not continue exactly as the original.
+    void setSparse(bool sparse);
+
+    // With a pyramid, actors sense from distance `from` on in coarse levels of the board, rebuilt every `interval`
+    // generations (see Pyramid.h), instead of every third cell: a sample at distance d reads one mean over a block of
+    // about d/4 cells. Makes long sensor ranges cheap at the price of a slightly stale and blurred view. 0 disables
+    // it. A reset or restore rebuilds the pyramid from the board it starts with, so a restored run does not continue
+    // exactly as the original. Throws Exception on negative distances or non-positive intervals.
+    void setPyramid(int from, int interval);
+
+    // Work-group sizes of the next step(). Throws Exception on non-positive sizes; sizes the device rejects surface as
+    // cl::Error from step().
+    void setLaunchShape(const LaunchShape &shape);
+
+    // Times every launch of step() and draw() with `profiler`, which needs a queue with profiling enabled. Null stops
+    // profiling. The profiler must outlive the simulation or be unset first.
+    void setProfiler(Profiler *profiler);
+
+    // Enqueues `generations` generations without waiting for them.
+    void step(int generations);
+    // Enqueues colorizing the visible part of the displayed member into the output.
+    void draw();
+
+    // Enqueues the telemetry reductions of all members and a non-blocking read of their results into `telemetry`,
+    // which is resized to members() and must stay untouched until `done` completes.
+    void measure(std::vector<Telemetry> &telemetry, cl::Event &done);
+
+    // Hash of the board, actors and generation of all members, to compare states between runs. Blocks.
+    [[nodiscard]] std::uint64_t checksum() const;
+
+    // Blocking reads of a single member.
+    void readCells(int member, std::vector<Cell> &cells) const;
+    void readActors(int member, std::vector<Actor> &actors) const;
+
+    [[nodiscard]] const cl::CommandQueue &queue() const;
+    // Device buffers of all members. Commands on them have to go through queue().
+    [[nodiscard]] const cl::Buffer &cells() const;
+    [[nodiscard]] const cl::Buffer &actors() const;
+    [[nodiscard]] const std::vector<Parameters> &parameters() const;
+    [[nodiscard]] int generation() const;
+    [[nodiscard]] int members() const;
+    [[nodiscard]] int2 boardSize() const;
+    [[nodiscard]] int actorsPerMember() const;
+    [[nodiscard]] int displayMember() const;
+    [[nodiscard]] const LaunchShape &launchShape() const;
+    [[nodiscard]] bool deterministic() const;
+    [[nodiscard]] bool sparse() const;
+    [[nodiscard]] int pyramidFrom() const;
+
+private:
+    void allocate(int2 boardSize, const std::vector<Parameters> &members);
+    void allocateDeterministic();
+    void allocateSparse();
+    void allocatePyramid();
+    [[nodiscard]] int2 tileGrid() const;
+    void resetActors(const std::vector<Parameters> &members, std::uint64_t seed, const SpawnRegion &spawn);
+    // Runs initActors() on the slots from `firstActor` on of `memberCount` members from `firstMember`.
+    void spawnActors(int firstMember, int memberCount, int firstActor, std::uint64_t seed, const SpawnRegion &spawn);
+    void ensureBuffer(cl::Buffer &buffer, std::size_t &capacity, std::size_t size, cl_mem_flags flags);
+
+    cl::Context m_context;
+    cl::Device m_device;
+    cl::CommandQueue m_queue;
+    cl::Kernel m_boardKernel;
+    cl::Kernel m_initBoardKernel;
+    cl::Kernel m_colorizeKernel;
+    cl::Kernel m_actorKernel;
+    cl::Kernel m_initActorsKernel;
+    cl::Kernel m_reduceCellsKernel;
+    cl::Kernel m_reduceActorsKernel;
+    cl::Kernel m_finishTelemetryKernel;
+    cl::Kernel m_diffuseKernel;
+    cl::Kernel m_commitTrailKernel;
+    cl::Kernel m_compactTilesKernel;
+    cl::Kernel m_finishTilesKernel;
+    cl::Kernel m_buildPyramidKernel;
+    FrameSequence m_sequence;
+    // Profiler names of the launches of one recorded step.
+    struct StepLaunch
+    {
+        const char *name;
+        double items;
+        const char *unit;
+    };
+    std::vector<StepLaunch> m_stepLaunches;
+    Profiler *m_profiler = nullptr;
+    LaunchShape m_launchShape;
+    bool m_deterministic = false;
+    bool m_sparse = false;
+    int m_pyramidFrom = 0;
+    int m_pyramidInterval = 1;
+    bool m_pyramidStale = false;
+
+    cl::Image m_output;
+    int2 m_outputSize{};
+    int m_displayMember = -1;
+    float2 m_viewOrigin{0, 0};
+    float m_viewScale = 1;
+
+    cl::Buffer m_cells;
+    std::size_t m_cellsCapacity = 0;
+    cl::Buffer m_actors;
+    std::size_t m_actorsCapacity = 0;
+    cl::Buffer m_parameters;
+    std::size_t m_parametersCapacity = 0;
+    cl::Buffer m_generationCounter;
+    // Only allocated in deterministic mode.
+    cl::Buffer m_deposits;
+    std::size_t m_depositsCapacity = 0;
+    cl::Buffer m_nextTrail;
+    std::size_t m_nextTrailCapacity = 0;
+    // Only allocated in sparse mode: per tile flags of this and the next generation, and per member lists of active
+    // tiles with their counts.
+    cl::Buffer m_tileFlags;
+    std::size_t m_tileFlagsCapacity = 0;
+    cl::Buffer m_nextTileFlags;
+    std::size_t m_nextTileFlagsCapacity = 0;
+    cl::Buffer m_tiles;
+    std::size_t m_tilesCapacity = 0;
+    cl::Buffer m_tileCounts;
+    std::size_t m_tileCountsCapacity = 0;
+    // Only allocated with a pyramid.
+    cl::Buffer m_pyramid;
+    std::size_t m_pyramidCapacity = 0;
+    cl::Buffer m_telemetryPartials;
+    std::size_t m_telemetryPartialsCapacity = 0;
+    cl::Buffer m_telemetry;
+    std::size_t m_telemetryCapacity = 0;
+
+    std::vector<Parameters> m_parameterValues;
+    int2 m_boardSize{};
+    int m_members = 0;
+    int m_actorsPerMember = 0;
+    int m_generation = 0;
+};
@@ -0,0 +1,319 @@
+#include "Snapshot.h"
+
+#include "Exception.h"
+#include "ThreadPool.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+const char snapshotMagic[8] = {'S', 'L', 'I', 'M', 'E', 'S', 'N', 'P'};
+const std::uint32_t snapshotVersion = 1;
+
+static_assert(sizeof(SnapshotHeader) == 56, "SnapshotHeader has padding");
+
+struct TileIndexEntry
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+void putVarint(std::vector<std::uint8_t> &out, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t zigzag(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// Reads varints from a tile, throwing on truncated or overlong data.
+class VarintReader
+{
+public:
+    VarintReader(const std::uint8_t *data, std::size_t size) :
+        m_data(data),
+        m_end(data + size)
+    { }
+
+    std::uint64_t next()
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (m_data == m_end)
+                throw Exception("Snapshot tile is truncated");
+            const std::uint8_t byte = *m_data++;
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw Exception("Snapshot tile has a malformed number");
+    }
+
+private:
+    const std::uint8_t *m_data;
+    const std::uint8_t *m_end;
+};
+
+struct TileRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+TileRect tileRect(const SnapshotHeader &header, int tx, int ty)
+{
+    const int x = tx * header.tileSize;
+    const int y = ty * header.tileSize;
+    return {x, y, std::min(header.tileSize, header.width - x), std::min(header.tileSize, header.height - y)};
+}
+
+std::vector<std::uint8_t> encodeTile(const std::vector<Cell> &cells, int boardWidth, const TileRect &rect,
+                                     float trailStep)
+{
+    std::vector<std::uint8_t> runs;
+    std::vector<std::uint8_t> trails;
+    std::uint64_t runCount = 0;
+    std::uint64_t run = 0;
+    bool solid = false;
+    std::int64_t previous = 0;
+    const double maxLevel = static_cast<double>(std::numeric_limits<std::int32_t>::max());
+
+    for (int y = rect.y; y < rect.y + rect.height; ++y)
+        for (int x = rect.x; x < rect.x + rect.width; ++x)
+        {
+            const Cell &cell = cells[static_cast<std::size_t>(y) * boardWidth + x];
+            if (cell.solid != solid)
+            {
+                putVarint(runs, run);
+                ++runCount;
+                run = 0;
+                solid = cell.solid;
+            }
+            ++run;
+
+            const std::int64_t level = static_cast<std::int64_t>(
+                    std::clamp(std::round(static_cast<double>(cell.trail) / trailStep), -maxLevel, maxLevel));
+            putVarint(trails, zigzag(level - previous));
+            previous = level;
+        }
+    putVarint(runs, run);
+    ++runCount;
+
+    std::vector<std::uint8_t> tile;
+    putVarint(tile, runCount);
+    tile.insert(tile.end(), runs.begin(), runs.end());
+    tile.insert(tile.end(), trails.begin(), trails.end());
+    return tile;
+}
+
+// Decodes a tile into `out`, whose rows are `stride` cells apart, skipping the cells outside `clip`.
+void decodeTile(const std::uint8_t *data, std::size_t size, const TileRect &rect, float trailStep,
+                const TileRect &clip, Cell *out, std::size_t stride)
+{
+    VarintReader reader(data, size);
+    const std::size_t count = static_cast<std::size_t>(rect.width) * rect.height;
+
+    std::vector<bool> solid(count);
+    const std::uint64_t runCount = reader.next();
+    std::size_t position = 0;
+    bool value = false;
+    for (std::uint64_t i = 0; i < runCount; ++i, value = !value)
+    {
+        const std::uint64_t run = reader.next();
+        if (run > count - position)
+            throw Exception("Snapshot tile has too many cells");
+        std::fill_n(solid.begin() + position, run, value);
+        position += run;
+    }
+    if (position != count)
+        throw Exception("Snapshot tile has too few cells");
+
+    std::int64_t level = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        level += unzigzag(reader.next());
+        const int x = rect.x + static_cast<int>(i % rect.width);
+        const int y = rect.y + static_cast<int>(i / rect.width);
+        if (x < clip.x || x >= clip.x + clip.width || y < clip.y || y >= clip.y + clip.height)
+            continue;
+        Cell &cell = out[static_cast<std::size_t>(y - clip.y) * stride + (x - clip.x)];
+        cell.solid = solid[i];
+        cell.trail = static_cast<float>(level * static_cast<double>(trailStep));
+    }
+}
+
+}
+
+void writeSnapshot(const std::string &path, const std::vector<Cell> &cells, int2 boardSize, int member,
+                   int generation, ThreadPool &pool, const SnapshotOptions &options)
+{
+    if (options.tileSize < 1 || !(options.trailStep > 0))
+        throw Exception("Snapshot tiles need a positive size and trail step");
+    if (cells.size() != static_cast<std::size_t>(boardSize.x) * boardSize.y)
+        throw Exception(fmt::format("{} cells do not make a {}x{} board", cells.size(), boardSize.x, boardSize.y));
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.tileSize = options.tileSize;
+    header.width = boardSize.x;
+    header.height = boardSize.y;
+    header.tilesX = (boardSize.x + options.tileSize - 1) / options.tileSize;
+    header.tilesY = (boardSize.y + options.tileSize - 1) / options.tileSize;
+    header.member = member;
+    header.trailStep = options.trailStep;
+    header.generation = generation;
+    header.indexOffset = sizeof(SnapshotHeader);
+
+    const std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw Exception(fmt::format("Unable to write {}", temporary));
+
+    std::vector<std::future<std::vector<std::uint8_t>>> tiles;
+    for (int ty = 0; ty < header.tilesY; ++ty)
+        for (int tx = 0; tx < header.tilesX; ++tx)
+        {
+            const TileRect rect = tileRect(header, tx, ty);
+            tiles.push_back(pool.submit([&cells, rect, width = header.width, trailStep = header.trailStep]()
+            {
+                return encodeTile(cells, width, rect, trailStep);
+            }));
+        }
+
+    std::vector<TileIndexEntry> index(tiles.size());
+    std::uint64_t offset = header.indexOffset + sizeof(TileIndexEntry) * index.size();
+    // The index is only known once all tiles are encoded, it is written last.
+    out.seekp(static_cast<std::streamoff>(offset));
+    std::size_t i = 0;
+    try
+    {
+        for (; i < tiles.size(); ++i)
+        {
+            const std::vector<std::uint8_t> tile = tiles[i].get();
+            index[i] = {offset, tile.size()};
+            out.write(reinterpret_cast<const char *>(tile.data()), static_cast<std::streamsize>(tile.size()));
+            offset += tile.size();
+        }
+    }
+    catch (...)
+    {
+        // The remaining tasks still read `cells`, which the caller may free once we are gone.
+        for (; i < tiles.size(); ++i)
+            if (tiles[i].valid())
+                tiles[i].wait();
+        throw;
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(index.data()),
+              static_cast<std::streamsize>(sizeof(TileIndexEntry) * index.size()));
+    out.close();
+    if (!out)
+        throw Exception(fmt::format("Writing {} failed", temporary));
+    fs::rename(temporary, path);
+}
+
+Snapshot::Snapshot(const std::string &path) :
+    m_file(path)
+{
+    if (m_file.size() < sizeof(SnapshotHeader))
+        throw Exception(fmt::format("{} is not a snapshot", path));
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (std::memcmp(m_header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0)
+        throw Exception(fmt::format("{} is not a snapshot", path));
+    if (m_header.version != snapshotVersion)
+        throw Exception(fmt::format("{} has snapshot version {}, expected {}", path, m_header.version,
+                                    snapshotVersion));
+    if (m_header.tileSize < 1 || m_header.width < 1 || m_header.height < 1 || !(m_header.trailStep > 0)
+            || m_header.tilesX != (m_header.width + m_header.tileSize - 1) / m_header.tileSize
+            || m_header.tilesY != (m_header.height + m_header.tileSize - 1) / m_header.tileSize)
+        throw Exception(fmt::format("{} has an invalid header", path));
+    const std::uint64_t indexSize = sizeof(TileIndexEntry) * std::uint64_t(m_header.tilesX) * m_header.tilesY;
+    if (m_header.indexOffset > m_file.size() || indexSize > m_file.size() - m_header.indexOffset)
+        throw Exception(fmt::format("{} is truncated", path));
+}
+
+int2 Snapshot::boardSize() const
+{
+    return {m_header.width, m_header.height};
+}
+
+int Snapshot::tileSize() const
+{
+    return m_header.tileSize;
+}
+
+int2 Snapshot::tiles() const
+{
+    return {m_header.tilesX, m_header.tilesY};
+}
+
+int Snapshot::member() const
+{
+    return m_header.member;
+}
+
+int Snapshot::generation() const
+{
+    return static_cast<int>(m_header.generation);
+}
+
+std::vector<Cell> Snapshot::readTile(int tx, int ty) const
+{
+    if (tx < 0 || tx >= m_header.tilesX || ty < 0 || ty >= m_header.tilesY)
+        throw Exception(fmt::format("Snapshot has no tile ({}, {})", tx, ty));
+    const TileRect rect = tileRect(m_header, tx, ty);
+    return readRegion(rect.x, rect.y, rect.width, rect.height);
+}
+
+std::vector<Cell> Snapshot::readRegion(int x, int y, int width, int height) const
+{
+    const int x0 = std::clamp(x, 0, m_header.width);
+    const int y0 = std::clamp(y, 0, m_header.height);
+    const int x1 = std::clamp(x + width, x0, m_header.width);
+    const int y1 = std::clamp(y + height, y0, m_header.height);
+    const TileRect clip{x0, y0, x1 - x0, y1 - y0};
+    std::vector<Cell> cells(static_cast<std::size_t>(clip.width) * clip.height, Cell{false, 0.f});
+    if (cells.empty())
+        return cells;
+
+    TileIndexEntry entry{};
+    for (int ty = y0 / m_header.tileSize; ty <= (y1 - 1) / m_header.tileSize; ++ty)
+        for (int tx = x0 / m_header.tileSize; tx <= (x1 - 1) / m_header.tileSize; ++tx)
+        {
+            const std::size_t tile = static_cast<std::size_t>(ty) * m_header.tilesX + tx;
+            std::memcpy(&entry, m_file.data() + m_header.indexOffset + tile * sizeof(TileIndexEntry), sizeof(entry));
+            if (entry.offset > m_file.size() || entry.size > m_file.size() - entry.offset)
+                throw Exception(fmt::format("{}: tile ({}, {}) lies outside the file", m_file.path(), tx, ty));
+            decodeTile(m_file.data() + entry.offset, entry.size, tileRect(m_header, tx, ty), m_header.trailStep, clip,
+                       cells.data(), clip.width);
+        }
+    return cells;
+}
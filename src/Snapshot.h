@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "OpenClTypes.h"
+#include "assets/Cell.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Start of a snapshot file: one member's board cut into square tiles that are compressed independently. An index of
+// (offset, size) per tile, row by row, follows at indexOffset, so any region can be decoded without reading the rest.
+//
+// A tile holds its cells row by row. Solid flags are stored as run lengths, alternating between free and solid and
+// starting with free. Trails are quantized to multiples of trailStep and stored as differences to the previous cell.
+// All numbers are LEB128 varints, differences zigzag encoded.
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t tileSize;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t tilesX;
+    std::int32_t tilesY;
+    std::int32_t member;
+    float trailStep;
+    std::int64_t generation;
+    std::uint64_t indexOffset;
+};
+
+struct SnapshotOptions
+{
+    int tileSize = 256;
+    // Trails are stored to this precision, finer steps compress worse.
+    float trailStep = 1.f / 64;
+};
+
+// Writes the board `cells` of `boardSize` to `path`, encoding the tiles in parallel on `pool`. Throws Exception on
+// I/O errors.
+void writeSnapshot(const std::string &path, const std::vector<Cell> &cells, int2 boardSize, int member,
+                   int generation, ThreadPool &pool, const SnapshotOptions &options = {});
+
+// A snapshot file, mapped into memory. Only the tiles that are read get decoded, or even loaded from disk.
+class Snapshot
+{
+public:
+    // Throws Exception if `path` is not a valid snapshot.
+    explicit Snapshot(const std::string &path);
+
+    [[nodiscard]] int2 boardSize() const;
+    [[nodiscard]] int tileSize() const;
+    [[nodiscard]] int2 tiles() const;
+    [[nodiscard]] int member() const;
+    [[nodiscard]] int generation() const;
+
+    // Cells of tile (tx, ty), row by row. Edge tiles are smaller than tileSize().
+    [[nodiscard]] std::vector<Cell> readTile(int tx, int ty) const;
+    // Cells of the rectangle at (x, y), row by row, clipped to the board. Decodes only the tiles it overlaps.
+    [[nodiscard]] std::vector<Cell> readRegion(int x, int y, int width, int height) const;
+
+private:
+    MappedFile m_file;
+    SnapshotHeader m_header{};
+};
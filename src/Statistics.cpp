@@ -0,0 +1,24 @@
+#include "Statistics.h"
+
+#include <fmt/core.h>
+
+Statistics Statistics::of(const Telemetry &telemetry)
+{
+    Statistics s;
+    s.aliveActors = telemetry.aliveActors;
+    s.meanSpeed = telemetry.meanSpeed;
+    s.totalTrail = telemetry.totalTrail;
+    s.maxTrail = telemetry.maxTrail;
+    s.coverage = telemetry.coverage;
+    return s;
+}
+
+std::string Statistics::csvHeader()
+{
+    return "aliveActors,meanSpeed,totalTrail,maxTrail,coverage";
+}
+
+std::string Statistics::csv() const
+{
+    return fmt::format("{},{},{},{},{}", aliveActors, meanSpeed, totalTrail, maxTrail, coverage);
+}
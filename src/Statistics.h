@@ -0,0 +1,23 @@
+#pragma once
+
+#include "assets/Telemetry.h"
+
+#include <string>
+
+// Summary of one board and its actors, as written by the parameter sweep.
+struct Statistics
+{
+    int aliveActors = 0;
+    double meanSpeed = 0;
+    double totalTrail = 0;
+    double maxTrail = 0;
+    // Fraction of free cells with a trail above coverageThreshold.
+    double coverage = 0;
+
+    static constexpr float coverageThreshold = 0.1f;
+
+    [[nodiscard]] static Statistics of(const Telemetry &telemetry);
+
+    [[nodiscard]] static std::string csvHeader();
+    [[nodiscard]] std::string csv() const;
+};
@@ -0,0 +1,303 @@
+#include "StripRunner.h"
+
+#include "Exception.h"
+#include "ParameterTable.h"
+#include "ProgramBuilder.h"
+#include "ProgramCache.h"
+#include "Profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+const int defaultBoardWidth = 1024;
+const int defaultBoardHeight = 1024;
+
+// Actors a strip can hand on per generation; the rest follow in the next ones.
+const int transferCapacity = 1 << 16;
+
+inline unsigned divup(unsigned a, unsigned b)
+{
+    return (a + b - 1) / b;
+}
+
+std::vector<cl::Device> allDevices(cl_device_type type)
+{
+    std::vector<cl::Device> devices;
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const cl::Platform &platform : platforms)
+    {
+        std::vector<cl::Device> platformDevices;
+        try
+        {
+            platform.getDevices(type, &platformDevices);
+        }
+        catch (const cl::Error &)
+        {
+            continue; // CL_DEVICE_NOT_FOUND
+        }
+        devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    return devices;
+}
+
+}
+
+StripRunner::StripRunner(const Settings &settings) :
+    m_settings(settings),
+    m_boardSize{settings.boardWidth ? settings.boardWidth : defaultBoardWidth,
+                settings.boardHeight ? settings.boardHeight : defaultBoardHeight}
+{
+    Parameters parameters = defaultParameters();
+    if (!m_settings.parameterTable.empty())
+        parameters = loadParameterTable(m_settings.parameterTable).front();
+    if (m_settings.actorCount)
+        parameters.actorCount = std::max(*m_settings.actorCount, 0);
+    m_halo = parameters.senseMax + 1;
+    if (m_settings.profileInterval > 0)
+        m_profiler = std::make_unique<Profiler>();
+
+    // Rows in proportion to compute units. Every strip needs at least a halo of rows, its neighbours' halos come
+    // from them.
+    const std::vector<cl::Device> devices = this->devices();
+    std::size_t computeUnits = 0;
+    for (const cl::Device &device : devices)
+        computeUnits += device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    int row = 0;
+    std::size_t unitsBefore = 0;
+    m_strips.resize(devices.size());
+    for (std::size_t i = 0; i < devices.size(); ++i)
+    {
+        Strip &strip = m_strips[i];
+        strip.device = devices[i];
+        unitsBefore += devices[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        strip.ownedFrom = row;
+        strip.ownedTo = static_cast<int>(m_boardSize.y * unitsBefore / computeUnits);
+        row = strip.ownedTo;
+        if (strip.ownedTo - strip.ownedFrom < m_halo)
+            throw Exception(fmt::format("{} rows are too few for {} strips with a halo of {} rows", m_boardSize.y,
+                                        devices.size(), m_halo));
+    }
+
+    // Every strip spawns the whole population and keeps the actors in its rows, so each actor has one owner and
+    // the population matches the single device one. Not for mask spawns, which sample free cells of the strip's own
+    // board (see Settings::parse()). Each strip has room for all actors, which may crowd into it.
+    // A fixed seed, as in sweeps: the same board and devices simulate the same population.
+    const std::uint64_t seed = 1;
+    const SpawnRegion spawn = SpawnRegion::centered(m_settings.spawn, m_boardSize);
+    for (Strip &strip : m_strips)
+    {
+        strip.context = cl::Context(strip.device);
+        const ProgramCache programCache(m_settings.programCache.value_or(ProgramCache::defaultDirectory()));
+        ProgramBuilder programBuilder(strip.context, strip.device, programCache);
+        const std::shared_future<cl::Program> boardBuild = programBuilder.build(embeddedSource("Board.cl"));
+        const std::shared_future<cl::Program> actorBuild = programBuilder.build(embeddedSource("Actor.cl"));
+        const cl::CommandQueue queue(strip.context, strip.device, m_profiler ? CL_QUEUE_PROFILING_ENABLE : 0);
+        strip.simulation = std::make_unique<Simulation>(strip.context, strip.device, queue, boardBuild.get(),
+                                                        actorBuild.get());
+        strip.simulation->setProfiler(m_profiler.get());
+        strip.emigrate = cl::Kernel(actorBuild.get(), "emigrate");
+        strip.immigrate = cl::Kernel(actorBuild.get(), "immigrate");
+        strip.transfer = cl::Buffer(strip.context, CL_MEM_READ_WRITE, sizeof(Actor) * transferCapacity);
+        strip.transferCount = cl::Buffer(strip.context, CL_MEM_READ_WRITE, sizeof(cl_int));
+        strip.taken = cl::Buffer(strip.context, CL_MEM_READ_WRITE, sizeof(cl_int));
+        strip.sendUp.resize(std::size_t(m_halo) * m_boardSize.x);
+        strip.sendDown.resize(std::size_t(m_halo) * m_boardSize.x);
+
+        strip.top = std::max(strip.ownedFrom - m_halo, 0);
+        const int bottom = std::min(strip.ownedTo + m_halo, m_boardSize.y);
+        SpawnRegion local = spawn;
+        local.center.y -= strip.top;
+        strip.simulation->resetRows({m_boardSize.x, bottom - strip.top}, strip.top, m_boardSize.y, {parameters}, seed,
+                                    local);
+
+        strip.emigrate.setArg(0, strip.simulation->actors());
+        strip.emigrate.setArg(1, strip.simulation->actorsPerMember());
+        strip.emigrate.setArg(2, int2{strip.ownedFrom - strip.top, strip.ownedTo - strip.top});
+        strip.emigrate.setArg(3, cl::Buffer());
+        strip.emigrate.setArg(4, strip.transferCount);
+        strip.emigrate.setArg(5, 0);
+        if (strip.simulation->actorsPerMember() > 0)
+            strip.simulation->queue().enqueueNDRangeKernel(strip.emigrate, cl::NullRange,
+                                                           cl::NDRange(strip.simulation->actorsPerMember()));
+        strip.emigrate.setArg(3, strip.transfer);
+        strip.emigrate.setArg(5, transferCapacity);
+        std::cout << fmt::format("Rows {} to {} on {}", strip.ownedFrom, strip.ownedTo,
+                                 strip.device.getInfo<CL_DEVICE_NAME>()) << std::endl;
+    }
+    // The halos of the fresh boards are walls, they need their neighbours' rows before the first generation.
+    exchange();
+}
+
+StripRunner::~StripRunner() = default;
+
+int StripRunner::run()
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int generation = 0; generation < m_settings.sweepGenerations; ++generation)
+    {
+        for (Strip &strip : m_strips)
+            strip.simulation->step(1);
+        exchange();
+        if (m_profiler)
+            m_profiler->poll();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The summary only counts the rows and actors each strip owns.
+    int alive = 0;
+    double trail = 0;
+    std::vector<Cell> cells;
+    std::vector<Actor> actors;
+    for (const Strip &strip : m_strips)
+    {
+        strip.simulation->readCells(0, cells);
+        for (std::size_t i = std::size_t(strip.ownedFrom - strip.top) * m_boardSize.x;
+             i < std::size_t(strip.ownedTo - strip.top) * m_boardSize.x; ++i)
+            trail += cells[i].trail;
+        strip.simulation->readActors(0, actors);
+        alive += static_cast<int>(std::count_if(actors.begin(), actors.end(), [](const Actor &a) { return a.alive; }));
+    }
+    std::cout << fmt::format("{} generations of {}x{} on {} strips in {:.2f} s, {:.1f} generations/s, {} actors alive, "
+                             "total trail {:.1f}", m_settings.sweepGenerations, m_boardSize.x, m_boardSize.y,
+                             m_strips.size(), seconds, m_settings.sweepGenerations / seconds, alive, trail)
+              << std::endl;
+    if (m_profiler)
+    {
+        m_profiler->poll(true);
+        std::cout << m_profiler->report() << std::endl;
+    }
+    return 0;
+}
+
+std::vector<cl::Device> StripRunner::devices() const
+{
+    const std::string &spec = m_settings.strips;
+    std::vector<cl::Device> devices;
+    if (spec == "gpu")
+        devices = allDevices(CL_DEVICE_TYPE_GPU);
+    else if (spec == "all")
+        devices = allDevices(CL_DEVICE_TYPE_ALL);
+    else if (spec.rfind("cpu:", 0) == 0)
+    {
+        const int count = std::atoi(spec.c_str() + 4);
+        std::vector<cl::Device> cpus = allDevices(CL_DEVICE_TYPE_CPU);
+        if (count < 1 || cpus.empty())
+            throw Exception(fmt::format("--strips={} needs a positive count and a CPU device", spec));
+        // Sub-devices of equal size, each with its own share of the compute units.
+        const cl_uint units = cpus.front().getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        const cl_device_partition_property properties[] = {
+                CL_DEVICE_PARTITION_EQUALLY, static_cast<cl_device_partition_property>(std::max(units / count, 1u)), 0};
+        cpus.front().createSubDevices(properties, &devices);
+        devices.resize(std::min<std::size_t>(devices.size(), count));
+    }
+    else
+        throw Exception(fmt::format("Invalid value '{}' for option --strips, expected gpu, all or cpu:N", spec));
+    if (devices.empty())
+        throw Exception(fmt::format("No OpenCL devices found for --strips={}", spec));
+    return devices;
+}
+
+void StripRunner::exchange()
+{
+    // Hands the halos and actors of the previous exchange over, then collects the new ones once the generation is
+    // done. Each strip only writes from its own host copies, which nothing touches until everything has completed.
+    for (std::size_t i = 0; i < m_strips.size(); ++i)
+    {
+        Strip &strip = m_strips[i];
+        const cl::CommandQueue &queue = strip.simulation->queue();
+        const std::size_t rowBytes = sizeof(Cell) * m_boardSize.x;
+        if (i > 0)
+            queue.enqueueReadBuffer(strip.simulation->cells(), false, rowBytes * (strip.ownedFrom - strip.top),
+                                    rowBytes * m_halo, strip.sendUp.data());
+        if (i + 1 < m_strips.size())
+            queue.enqueueReadBuffer(strip.simulation->cells(), false, rowBytes * (strip.ownedTo - m_halo - strip.top),
+                                    rowBytes * m_halo, strip.sendDown.data());
+        queue.enqueueFillBuffer(strip.transferCount, cl_int(0), 0, sizeof(cl_int));
+        const int slots = strip.simulation->actorsPerMember();
+        if (slots > 0)
+            queue.enqueueNDRangeKernel(strip.emigrate, cl::NullRange, cl::NDRange(64 * divup(slots, 64)),
+                                       cl::NDRange(64));
+        queue.enqueueReadBuffer(strip.transferCount, false, 0, sizeof(cl_int), &strip.leavingCount);
+    }
+    finish();
+
+    for (Strip &strip : m_strips)
+    {
+        strip.leaving.assign(std::min(strip.leavingCount, transferCapacity), Actor{{0, 0}, 0, 0, 0, false});
+        if (!strip.leaving.empty())
+            strip.simulation->queue().enqueueReadBuffer(strip.transfer, false, 0, sizeof(Actor) * strip.leaving.size(),
+                                                        strip.leaving.data());
+    }
+    finish();
+
+    // Emigrants go to the strip that owns their row, in its coordinates.
+    for (Strip &strip : m_strips)
+        strip.arrivals.clear();
+    for (const Strip &strip : m_strips)
+        for (Actor actor : strip.leaving)
+        {
+            const float y = actor.pos.y + strip.top;
+            Strip &owner = m_strips[this->owner(static_cast<int>(std::lround(y)))];
+            actor.pos.y = y - owner.top;
+            owner.arrivals.push_back(actor);
+        }
+
+    for (std::size_t i = 0; i < m_strips.size(); ++i)
+    {
+        Strip &strip = m_strips[i];
+        const cl::CommandQueue &queue = strip.simulation->queue();
+        const std::size_t rowBytes = sizeof(Cell) * m_boardSize.x;
+        // The halo above is the bottom of the strip above, the one below the top of the strip below.
+        if (i > 0)
+            queue.enqueueWriteBuffer(strip.simulation->cells(), true, 0, rowBytes * m_halo,
+                                     m_strips[i - 1].sendDown.data());
+        if (i + 1 < m_strips.size())
+            queue.enqueueWriteBuffer(strip.simulation->cells(), true, rowBytes * (strip.ownedTo - strip.top),
+                                     rowBytes * m_halo, m_strips[i + 1].sendUp.data());
+        if (strip.arrivals.empty())
+            continue;
+
+        const std::size_t bytes = sizeof(Actor) * strip.arrivals.size();
+        if (bytes > strip.arrivingCapacity)
+        {
+            strip.arriving = cl::Buffer(strip.context, CL_MEM_READ_ONLY, bytes);
+            strip.arrivingCapacity = bytes;
+        }
+        queue.enqueueWriteBuffer(strip.arriving, true, 0, bytes, strip.arrivals.data());
+        queue.enqueueFillBuffer(strip.taken, cl_int(0), 0, sizeof(cl_int));
+        const int slots = strip.simulation->actorsPerMember();
+        const int count = static_cast<int>(strip.arrivals.size());
+        strip.immigrate.setArg(0, strip.simulation->actors());
+        strip.immigrate.setArg(1, slots);
+        strip.immigrate.setArg(2, strip.simulation->cells());
+        strip.immigrate.setArg(3, strip.simulation->boardSize());
+        strip.immigrate.setArg(4, strip.arriving);
+        strip.immigrate.setArg(5, count);
+        strip.immigrate.setArg(6, strip.taken);
+        queue.enqueueNDRangeKernel(strip.immigrate, cl::NullRange, cl::NDRange(64 * divup(std::max(slots, count), 64)),
+                                   cl::NDRange(64));
+    }
+}
+
+void StripRunner::finish()
+{
+    for (const Strip &strip : m_strips)
+        strip.simulation->queue().finish();
+}
+
+int StripRunner::owner(int row) const
+{
+    for (std::size_t i = 0; i < m_strips.size(); ++i)
+        if (row < m_strips[i].ownedTo)
+            return static_cast<int>(i);
+    return static_cast<int>(m_strips.size()) - 1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "Settings.h"
+#include "Simulation.h"
+#include "assets/Actor.h"
+#include "assets/Cell.h"
+#include "assets/Parameters.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Profiler;
+
+// Simulates one board headless across several OpenCL devices, or sub-devices of the CPU. The board is cut into
+// horizontal strips, one per device, sized by compute units. Each strip is a Simulation of its own rows plus a halo
+// of senseMax + 1 rows of each neighbour, so actors sense across the cut. After every generation the halos are
+// refreshed from the neighbours, and the actors that crossed into a neighbour's rows move there through small
+// transfer buffers, repeating the deposit they made in the halo. Everything between devices goes through the host,
+// as devices of different platforms share no context.
+class StripRunner
+{
+public:
+    // Throws Exception if the devices of settings.strips cannot be found or the board is too small for them.
+    explicit StripRunner(const Settings &settings);
+    ~StripRunner();
+
+    StripRunner(const StripRunner &) = delete;
+    StripRunner &operator=(const StripRunner &) = delete;
+
+    // Simulates settings.sweepGenerations generations and prints throughput and a summary. Returns 0 on success.
+    int run();
+
+private:
+    struct Strip
+    {
+        cl::Device device;
+        cl::Context context;
+        std::unique_ptr<Simulation> simulation;
+        cl::Kernel emigrate;
+        cl::Kernel immigrate;
+        cl::Buffer transfer;
+        cl::Buffer transferCount;
+        cl::Buffer arriving;
+        std::size_t arrivingCapacity = 0;
+        cl::Buffer taken;
+        // Global rows: the board of the simulation starts at `top`, the strip owns [ownedFrom, ownedTo).
+        int top = 0;
+        int ownedFrom = 0;
+        int ownedTo = 0;
+        // Host copies, kept until the commands reading or writing them have completed.
+        std::vector<Cell> sendUp;
+        std::vector<Cell> sendDown;
+        std::vector<Actor> leaving;
+        cl_int leavingCount = 0;
+        std::vector<Actor> arrivals;
+    };
+
+    [[nodiscard]] std::vector<cl::Device> devices() const;
+    // Refreshes the halos and moves the actors that left their strip. Blocks until all strips are done.
+    void exchange();
+    void finish();
+    [[nodiscard]] int owner(int row) const;
+
+    const Settings m_settings;
+    int2 m_boardSize{};
+    int m_halo = 0;
+    std::vector<Strip> m_strips;
+    std::unique_ptr<Profiler> m_profiler;
+};
@@ -0,0 +1,211 @@
+#include "SweepRunner.h"
+
+#include "Exception.h"
+#include "LaunchTuner.h"
+#include "ParameterTable.h"
+#include "ProgramBuilder.h"
+#include "ProgramCache.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "Statistics.h"
+#include "TelemetryRecorder.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+
+// Generations recorded into one frame sequence; longer runs replay it several times.
+const int generationsPerReplay = 100;
+
+const int defaultBoardWidth = 1024;
+const int defaultBoardHeight = 1024;
+
+std::string quoted(std::string text)
+{
+    std::replace(text.begin(), text.end(), '"', '\'');
+    return '"' + text + '"';
+}
+
+}
+
+SweepRunner::SweepRunner(const Settings &settings) :
+    m_settings(settings),
+    m_grid(loadParameterGrid(settings.sweep))
+{
+    m_batches = (m_grid.size() + m_settings.sweepBatch - 1) / m_settings.sweepBatch;
+
+    m_output.open(m_settings.sweepOutput);
+    if (!m_output)
+        throw Exception(fmt::format("Unable to write {}", m_settings.sweepOutput));
+    std::string header = "index";
+    for (const std::string &name : parameterNames())
+        header += "," + name;
+    m_output << header << ",generations," << Statistics::csvHeader() << ",device,seconds" << std::endl;
+
+    if (!m_settings.telemetry.empty())
+        m_telemetry = std::make_unique<TelemetryRecorder>(m_settings.telemetry, "index");
+    if (m_settings.profileInterval > 0)
+        m_profiler = std::make_unique<Profiler>();
+}
+
+SweepRunner::~SweepRunner() = default;
+
+int SweepRunner::run()
+{
+    std::vector<cl::Device> devices;
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    for (const cl::Platform &platform : platforms)
+    {
+        std::vector<cl::Device> platformDevices;
+        try
+        {
+            platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices);
+        }
+        catch (const cl::Error &)
+        {
+            continue; // CL_DEVICE_NOT_FOUND
+        }
+        devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    if (devices.empty())
+        throw Exception("No OpenCL devices found");
+
+    const int2 boardSize{m_settings.boardWidth ? m_settings.boardWidth : defaultBoardWidth,
+                         m_settings.boardHeight ? m_settings.boardHeight : defaultBoardHeight};
+    std::cout << fmt::format("Sweeping {} configurations in {} batches on {} devices", m_grid.size(), m_batches,
+                             devices.size()) << std::endl;
+
+    std::vector<std::thread> threads;
+    for (const cl::Device &device : devices)
+        threads.emplace_back(&SweepRunner::runDevice, this, device, boardSize);
+    for (std::thread &thread : threads)
+        thread.join();
+    if (m_telemetry)
+        m_telemetry->poll(true);
+    if (m_profiler)
+    {
+        m_profiler->poll(true);
+        std::cout << m_profiler->report() << std::endl;
+    }
+
+    // Batches nobody could take, e.g. because no device built the programs.
+    const std::size_t started = std::min(m_nextBatch.load(), m_batches);
+    for (std::size_t batch = started; batch < m_batches; ++batch)
+        m_failed += static_cast<int>(std::min<std::size_t>(m_settings.sweepBatch, m_grid.size() - batch * m_settings.sweepBatch));
+    return m_failed;
+}
+
+void SweepRunner::runDevice(const cl::Device &device, int2 boardSize)
+{
+    const std::string name = device.getInfo<CL_DEVICE_NAME>();
+    try
+    {
+        cl::Context context(device);
+        const ProgramCache programCache(m_settings.programCache.value_or(ProgramCache::defaultDirectory()));
+        ProgramBuilder programBuilder(context, device, programCache);
+        const std::shared_future<cl::Program> boardBuild = programBuilder.build(embeddedSource("Board.cl"));
+        const std::shared_future<cl::Program> actorBuild = programBuilder.build(embeddedSource("Actor.cl"));
+        const cl::Program boardProgram = boardBuild.get();
+        const cl::Program actorProgram = actorBuild.get();
+
+        // Tuned for the first batch, the others have the same board and a similar number of actors.
+        LaunchShape shape;
+        if (m_settings.tune)
+        {
+            const std::vector<Parameters> firstBatch(m_grid.begin(), m_grid.begin() + std::min<std::size_t>(
+                    m_settings.sweepBatch, m_grid.size()));
+            shape = LaunchTuner(programCache.directory()).tune(context, device, boardProgram, actorProgram, boardSize,
+                                                               firstBatch, m_settings.retune);
+        }
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < m_settings.sweepJobsPerDevice; ++i)
+            workers.emplace_back(&SweepRunner::work, this, context, device, boardProgram, actorProgram, boardSize,
+                                 shape);
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+    catch (const cl::Error &error)
+    {
+        std::cerr << fmt::format("{}: {}({}), device skipped", name, error.what(), error.err()) << std::endl;
+    }
+    catch (const Exception &e)
+    {
+        std::cerr << fmt::format("{}: {}, device skipped", name, e.what()) << std::endl;
+    }
+}
+
+void SweepRunner::work(const cl::Context &context, const cl::Device &device, const cl::Program &boardProgram,
+                       const cl::Program &actorProgram, int2 boardSize, const LaunchShape &shape)
+{
+    const std::string deviceName = device.getInfo<CL_DEVICE_NAME>();
+    const cl::CommandQueue queue(context, device, m_profiler ? CL_QUEUE_PROFILING_ENABLE : 0);
+    Simulation simulation(context, device, queue, boardProgram, actorProgram);
+    simulation.setProfiler(m_profiler.get());
+    simulation.setLaunchShape(shape);
+    simulation.setDeterministic(m_settings.deterministic);
+    simulation.setSparse(m_settings.sparse);
+    simulation.setPyramid(m_settings.pyramidFrom, m_settings.pyramidInterval);
+    std::vector<Telemetry> telemetry;
+
+    for (std::size_t batch = m_nextBatch++; batch < m_batches; batch = m_nextBatch++)
+    {
+        const std::size_t first = batch * m_settings.sweepBatch;
+        const std::size_t count = std::min<std::size_t>(m_settings.sweepBatch, m_grid.size() - first);
+        const std::vector<Parameters> members(m_grid.begin() + first, m_grid.begin() + first + count);
+        try
+        {
+            const auto start = std::chrono::steady_clock::now();
+            // Seeded by batch, so a configuration gives the same result on every run of the same grid.
+            simulation.reset(boardSize, members, batch, SpawnRegion::centered(m_settings.spawn, boardSize));
+            int nextTelemetry = m_settings.telemetryInterval;
+            for (int remaining = m_settings.sweepGenerations; remaining > 0; remaining -= generationsPerReplay)
+            {
+                simulation.step(std::min(remaining, generationsPerReplay));
+                if (m_telemetry && simulation.generation() >= nextTelemetry)
+                {
+                    m_telemetry->record(simulation, first);
+                    m_telemetry->poll();
+                    nextTelemetry = simulation.generation() + m_settings.telemetryInterval;
+                }
+            }
+            if (m_profiler)
+                m_profiler->poll();
+            // The summary is reduced on the device as well, only a few numbers per configuration are read back.
+            cl::Event measured;
+            simulation.measure(telemetry, measured);
+            measured.wait();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (std::size_t m = 0; m < count; ++m)
+                write(first + m, Statistics::of(telemetry[m]), deviceName, seconds);
+        }
+        catch (const cl::Error &error)
+        {
+            std::cerr << fmt::format("{}: batch {} failed: {}({})", deviceName, batch, error.what(), error.err())
+                      << std::endl;
+            m_failed += static_cast<int>(count);
+        }
+        catch (const Exception &e)
+        {
+            std::cerr << fmt::format("{}: batch {} failed: {}", deviceName, batch, e.what()) << std::endl;
+            m_failed += static_cast<int>(count);
+        }
+    }
+}
+
+void SweepRunner::write(std::size_t index, const Statistics &statistics, const std::string &device, double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    m_output << fmt::format("{},{},{},{},{},{}", index, csv(m_grid[index]), m_settings.sweepGenerations,
+                            statistics.csv(), quoted(device), seconds) << std::endl;
+    std::cout << fmt::format("[{}/{}] {} on {}", ++m_done, m_grid.size(), describe(m_grid[index]), device)
+              << std::endl;
+}
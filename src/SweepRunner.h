@@ -0,0 +1,49 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "OpenClTypes.h"
+#include "Settings.h"
+#include "Simulation.h"
+#include "assets/Parameters.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct Statistics;
+class Profiler;
+class TelemetryRecorder;
+
+// Runs every configuration of a parameter grid headless and writes a line of summary statistics for each. Every
+// OpenCL device gets one context and one set of programs, shared by a few worker threads that take batches of
+// configurations from a common queue and simulate each batch as an ensemble.
+class SweepRunner
+{
+public:
+    explicit SweepRunner(const Settings &settings);
+    ~SweepRunner();
+
+    // Returns the number of configurations that could not be simulated.
+    int run();
+
+private:
+    void runDevice(const cl::Device &device, int2 boardSize);
+    void work(const cl::Context &context, const cl::Device &device, const cl::Program &boardProgram,
+              const cl::Program &actorProgram, int2 boardSize, const LaunchShape &shape);
+    void write(std::size_t index, const Statistics &statistics, const std::string &device, double seconds);
+
+    const Settings m_settings;
+    std::vector<Parameters> m_grid;
+    std::size_t m_batches = 0;
+    std::atomic<std::size_t> m_nextBatch{0};
+    std::atomic<std::size_t> m_done{0};
+    std::atomic<int> m_failed{0};
+
+    std::mutex m_outputMutex;
+    std::ofstream m_output;
+    std::unique_ptr<TelemetryRecorder> m_telemetry;
+    std::unique_ptr<Profiler> m_profiler;
+};
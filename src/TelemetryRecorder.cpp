@@ -0,0 +1,107 @@
+#include "TelemetryRecorder.h"
+
+#include "Exception.h"
+#include "Simulation.h"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+
+bool isJsonPath(const std::string &path)
+{
+    const std::string extension = std::filesystem::path(path).extension().string();
+    return extension == ".jsonl" || extension == ".json";
+}
+
+}
+
+TelemetryRecorder::TelemetryRecorder(const std::string &path, std::string indexName) :
+    m_indexName(std::move(indexName)),
+    m_json(isJsonPath(path))
+{
+    m_output.open(path);
+    if (!m_output)
+        throw Exception(fmt::format("Unable to write {}", path));
+    if (m_json)
+        return;
+    std::string header = fmt::format("generation,{},aliveActors,meanSpeed,totalTrail,maxTrail,coverage", m_indexName);
+    for (int bin = 0; bin < TELEMETRY_BINS; ++bin)
+        header += fmt::format(",bin{}", bin);
+    m_output << header << std::endl;
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    try
+    {
+        poll(true);
+    }
+    catch (const cl::Error &error)
+    {
+        std::cout << fmt::format("Telemetry lost: {}({})", error.what(), error.err()) << std::endl;
+    }
+}
+
+void TelemetryRecorder::record(Simulation &simulation, std::size_t firstIndex)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Pending &pending = m_pending.emplace_back();
+    pending.firstIndex = firstIndex;
+    try
+    {
+        simulation.measure(pending.results, pending.done);
+    }
+    catch (...)
+    {
+        m_pending.pop_back();
+        throw;
+    }
+    // Nothing else may be enqueued for a while, make sure the reductions get going.
+    simulation.queue().flush();
+}
+
+void TelemetryRecorder::poll(bool wait)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_pending.begin(); it != m_pending.end();)
+    {
+        if (wait)
+            it->done.wait();
+        const cl_int status = it->done.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+        if (status > CL_COMPLETE)
+        {
+            ++it;
+            continue;
+        }
+        if (status == CL_COMPLETE)
+            write(*it);
+        else
+            std::cout << fmt::format("Telemetry read failed: {}", status) << std::endl;
+        it = m_pending.erase(it);
+    }
+    m_output.flush();
+}
+
+void TelemetryRecorder::write(const Pending &pending)
+{
+    for (std::size_t m = 0; m < pending.results.size(); ++m)
+    {
+        const Telemetry &t = pending.results[m];
+        std::string histogram;
+        for (int bin = 0; bin < TELEMETRY_BINS; ++bin)
+            histogram += fmt::format(bin ? ",{}" : "{}", t.histogram[bin]);
+        if (m_json)
+            m_output << fmt::format("{{\"generation\":{},\"{}\":{},\"aliveActors\":{},\"meanSpeed\":{},"
+                                    "\"totalTrail\":{},\"maxTrail\":{},\"coverage\":{},\"histogram\":[{}]}}",
+                                    t.generation, m_indexName, pending.firstIndex + m, t.aliveActors, t.meanSpeed,
+                                    t.totalTrail, t.maxTrail, t.coverage, histogram) << '\n';
+        else
+            m_output << fmt::format("{},{},{},{},{},{},{},{}", t.generation, pending.firstIndex + m, t.aliveActors,
+                                    t.meanSpeed, t.totalTrail, t.maxTrail, t.coverage, histogram) << '\n';
+    }
+}
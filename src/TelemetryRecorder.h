@@ -0,0 +1,53 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+#include "assets/Telemetry.h"
+
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Simulation;
+
+// Streams the on-device telemetry of simulations to a CSV file, or to JSON lines if the path ends in .jsonl or .json.
+// record() only enqueues the reductions and the read of their results; lines are written by poll() once the reads
+// have completed, so the simulation never waits for them. Several simulations may record into one file from
+// different threads.
+class TelemetryRecorder
+{
+public:
+    // `indexName` labels the column identifying a result, e.g. the member in the window or the configuration in a
+    // sweep. Throws Exception if `path` cannot be written.
+    explicit TelemetryRecorder(const std::string &path, std::string indexName = "member");
+    // Writes what is still pending.
+    ~TelemetryRecorder();
+
+    TelemetryRecorder(const TelemetryRecorder &) = delete;
+    TelemetryRecorder &operator=(const TelemetryRecorder &) = delete;
+
+    // Measures every member of `simulation` as of the commands enqueued so far. Their results are labeled
+    // firstIndex + member.
+    void record(Simulation &simulation, std::size_t firstIndex = 0);
+    // Writes the results whose reads have completed. With `wait`, blocks until all pending results are written.
+    void poll(bool wait = false);
+
+private:
+    struct Pending
+    {
+        std::vector<Telemetry> results;
+        cl::Event done;
+        std::size_t firstIndex = 0;
+    };
+
+    void write(const Pending &pending);
+
+    const std::string m_indexName;
+    const bool m_json;
+    std::mutex m_mutex;
+    // A list keeps the result vectors in place while their reads are in flight.
+    std::list<Pending> m_pending;
+    std::ofstream m_output;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads taking tasks from a shared queue.
+class ThreadPool
+{
+public:
+    // 0 threads means one per hardware thread.
+    explicit ThreadPool(unsigned threads = 0);
+    // Finishes the queued tasks.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Queues `task`; its result or exception arrives through the future.
+    template<typename F>
+    auto submit(F task) -> std::future<decltype(task())>
+    {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        std::future<decltype(task())> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back([packaged]() { (*packaged)(); });
+        }
+        m_condition.notify_one();
+        return result;
+    }
+
+    [[nodiscard]] unsigned size() const;
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,94 @@
+#include "Tracer.h"
+
+#include "Exception.h"
+
+#include <fmt/core.h>
+
+namespace
+{
+
+// Process ids of the two timelines.
+const int hostProcess = 1;
+const int deviceProcess = 2;
+
+std::string escaped(const std::string &text)
+{
+    std::string result;
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+}
+
+Tracer::Span::Span(Tracer *tracer, const char *name) :
+    m_tracer(tracer),
+    m_name(name),
+    m_start(tracer ? tracer->now() : 0)
+{ }
+
+Tracer::Span::~Span()
+{
+    if (m_tracer)
+        m_tracer->host(m_name, m_start, m_tracer->now());
+}
+
+Tracer::Tracer(const std::string &path, const cl::CommandQueue &queue) :
+    m_origin(std::chrono::steady_clock::now())
+{
+    m_output.open(path);
+    if (!m_output)
+        throw Exception(fmt::format("Unable to write {}", path));
+    m_output << "[\n";
+    m_output << fmt::format(R"({{"name":"process_name","ph":"M","pid":{},"args":{{"name":"host"}}}})", hostProcess);
+    m_output << fmt::format(",\n"
+                            R"({{"name":"process_name","ph":"M","pid":{},"args":{{"name":"{}"}}}})", deviceProcess,
+                            escaped(queue.getInfo<CL_QUEUE_DEVICE>().getInfo<CL_DEVICE_NAME>()));
+
+    // The queued timestamp is taken on the device clock when the marker is enqueued, so halfway through the call.
+    cl::Event marker;
+    const std::int64_t before = now();
+    queue.enqueueMarkerWithWaitList(nullptr, &marker);
+    const std::int64_t after = now();
+    marker.wait();
+    const cl_ulong queued = marker.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+    m_deviceOffset = (before + after) / 2 - static_cast<std::int64_t>(queued);
+}
+
+Tracer::~Tracer()
+{
+    m_output << "\n]\n";
+}
+
+void Tracer::device(const std::string &name, cl_ulong start, cl_ulong end)
+{
+    const std::int64_t hostStart = static_cast<std::int64_t>(start) + m_deviceOffset;
+    write(fmt::format(R"({{"name":"{}","ph":"X","pid":{},"tid":1,"ts":{:.3f},"dur":{:.3f}}})", escaped(name),
+                      deviceProcess, hostStart * 1e-3, (end - start) * 1e-3));
+}
+
+std::int64_t Tracer::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+void Tracer::host(const char *name, std::int64_t start, std::int64_t end)
+{
+    int thread;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        thread = m_threads.emplace(std::this_thread::get_id(), static_cast<int>(m_threads.size()) + 1).first->second;
+    }
+    write(fmt::format(R"({{"name":"{}","ph":"X","pid":{},"tid":{},"ts":{:.3f},"dur":{:.3f}}})", escaped(name),
+                      hostProcess, thread, start * 1e-3, (end - start) * 1e-3));
+}
+
+void Tracer::write(const std::string &event)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_output << ",\n" << event;
+}
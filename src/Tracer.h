@@ -0,0 +1,61 @@
+#pragma once
+
+#include "OpenCLUtil.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes host spans and device command intervals as Trace Event JSON, for chrome://tracing or Perfetto. Device
+// timestamps are moved onto the host clock by an offset measured once with a marker, so both timelines line up.
+// Events are streamed to the file as they come in. Thread safe.
+class Tracer
+{
+public:
+    // Times the scope it lives in on the calling thread. Does nothing without a tracer.
+    class Span
+    {
+    public:
+        Span(Tracer *tracer, const char *name);
+        ~Span();
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        Tracer *m_tracer;
+        const char *m_name;
+        std::int64_t m_start;
+    };
+
+    // `queue` needs profiling enabled, its device clock is matched with the host clock here. Throws Exception if
+    // `path` cannot be written.
+    Tracer(const std::string &path, const cl::CommandQueue &queue);
+    // Completes the JSON array.
+    ~Tracer();
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    // Adds a device command that ran from `start` to `end`, in nanoseconds on the device clock. Fits
+    // Profiler::Listener.
+    void device(const std::string &name, cl_ulong start, cl_ulong end);
+
+private:
+    // Nanoseconds on the host clock since the tracer was created.
+    [[nodiscard]] std::int64_t now() const;
+    void host(const char *name, std::int64_t start, std::int64_t end);
+    void write(const std::string &event);
+
+    const std::chrono::steady_clock::time_point m_origin;
+    // Host minus device clock.
+    std::int64_t m_deviceOffset = 0;
+
+    std::mutex m_mutex;
+    std::ofstream m_output;
+    std::map<std::thread::id, int> m_threads;
+};
@@ -0,0 +1,63 @@
+#include "Viewport.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// Zoom limits in screen pixels per cell.
+const float minZoom = 1.f / 1024;
+const float maxZoom = 64;
+
+}
+
+Viewport::Viewport(int2 boardSize, int2 screenSize) :
+    m_boardSize(boardSize),
+    m_screenSize(screenSize)
+{
+    fit();
+}
+
+void Viewport::fit()
+{
+    m_center = {m_boardSize.x / 2.f, m_boardSize.y / 2.f};
+    m_zoom = std::clamp(std::min(float(m_screenSize.x) / m_boardSize.x, float(m_screenSize.y) / m_boardSize.y),
+                        minZoom, maxZoom);
+}
+
+void Viewport::setScreenSize(int2 screenSize)
+{
+    m_screenSize = screenSize;
+}
+
+void Viewport::pan(float dx, float dy)
+{
+    m_center.x = std::clamp(m_center.x - dx / m_zoom, 0.f, float(m_boardSize.x));
+    m_center.y = std::clamp(m_center.y - dy / m_zoom, 0.f, float(m_boardSize.y));
+}
+
+void Viewport::zoom(float factor, float x, float y)
+{
+    const float zoom = std::clamp(m_zoom * factor, minZoom, maxZoom);
+    // Board position under (x, y) before and after must match.
+    const float dx = x - m_screenSize.x / 2.f;
+    const float dy = y - m_screenSize.y / 2.f;
+    m_center.x += dx / m_zoom - dx / zoom;
+    m_center.y += dy / m_zoom - dy / zoom;
+    m_zoom = zoom;
+}
+
+float2 Viewport::origin() const
+{
+    return {m_center.x - m_screenSize.x / 2.f / m_zoom, m_center.y - m_screenSize.y / 2.f / m_zoom};
+}
+
+float Viewport::scale() const
+{
+    return 1 / m_zoom;
+}
+
+int2 Viewport::screenSize() const
+{
+    return m_screenSize;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "OpenClTypes.h"
+
+// Part of the board shown in the window. Keeps the board position under the window center and the zoom as screen
+// pixels per cell; everything else follows from the window size.
+class Viewport
+{
+public:
+    Viewport(int2 boardSize, int2 screenSize);
+
+    // Shows the whole board, centered.
+    void fit();
+    void setScreenSize(int2 screenSize);
+
+    // Moves the view by a distance in screen pixels.
+    void pan(float dx, float dy);
+    // Zooms by `factor`, keeping the board position under screen pixel (x, y) in place.
+    void zoom(float factor, float x, float y);
+
+    // Board position shown at the top left corner of the window.
+    [[nodiscard]] float2 origin() const;
+    // Cells per screen pixel.
+    [[nodiscard]] float scale() const;
+    [[nodiscard]] int2 screenSize() const;
+
+private:
+    int2 m_boardSize;
+    int2 m_screenSize;
+    float2 m_center{0, 0};
+    float m_zoom = 1;
+};
@@ -2,7 +2,27 @@
 #include "OpenClTypes.h"
 #include "assets/Actor.h"
 #include "Board.h"
+#include "Checkpoint.h"
+#include "ChecksumRun.h"
 #include "Exception.h"
+#include "FrameCapture.h"
+#include "KeyframeStore.h"
+#include "KernelWatcher.h"
+#include "LaunchTuner.h"
+#include "ParameterTable.h"
+#include "ProgramBuilder.h"
+#include "ProgramCache.h"
+#include "Roofline.h"
+#include "Profiler.h"
+#include "Settings.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "StripRunner.h"
+#include "SweepRunner.h"
+#include "TelemetryRecorder.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include "Viewport.h"
 
 #include "OpenCLUtil.h"
 #include "OpenGLUtil.h"
@@ -26,8 +46,11 @@
 
 #include <chrono>
 #include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <limits>
 #include <fstream>
+#include <memory>
 #include <random>
 #include <sstream>
 #include <string>
@@ -40,7 +63,6 @@ using uint = unsigned int;
 static const uint NUM_JSETS = 9;
 
 const int speed = 100;
-const int actorsCount = 10000;
 
 static const std::array<float, 16> matrix =
 {
@@ -76,14 +98,18 @@ struct process_params
     Device device;
     CommandQueue queue;
     Program boardProgram;
-    Kernel boardKernel;
     Program actorProgram;
-    Kernel actorKernel;
     ImageGL tex;
-    Buffer cells;
-    int2 boardSize{};
-    Buffer actors;
-    int actorSize = 0;
+    std::unique_ptr<Simulation> simulation;
+    // Only set with --profile or --trace.
+    std::unique_ptr<Profiler> profiler;
+    std::unique_ptr<Tracer> tracer;
+    bool checkpointRequested = false;
+    bool snapshotRequested = false;
+    bool checksumRequested = false;
+    // Factor the [ and ] keys apply to the population, 1 while there is no change.
+    float actorScale = 1;
+    bool captureToggled = false;
 };
 
 struct render_params
@@ -91,6 +117,11 @@ struct render_params
     GLuint prg;
     GLuint vao;
     GLuint tex;
+    // The texture has the size of the framebuffer, the viewport picks the part of the board drawn into it.
+    std::unique_ptr<Viewport> viewport;
+    bool dragging = false;
+    double cursorX = 0;
+    double cursorY = 0;
 };
 
 process_params params;
@@ -106,7 +137,80 @@ static void glfw_key_callback(GLFWwindow* wind, int key, int scancode, int actio
     if (action == GLFW_PRESS) {
         if (key == GLFW_KEY_ESCAPE)
             glfwSetWindowShouldClose(wind, GL_TRUE);
+        if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9 && key - GLFW_KEY_1 < params.simulation->members())
+            params.simulation->setDisplayMember(key - GLFW_KEY_1);
+        if (key == GLFW_KEY_0)
+            rparams.viewport->fit();
+        if (key == GLFW_KEY_S)
+            params.checkpointRequested = true;
+        if (key == GLFW_KEY_P)
+            params.snapshotRequested = true;
+        if (key == GLFW_KEY_H)
+            params.checksumRequested = true;
+        if (key == GLFW_KEY_LEFT_BRACKET)
+            params.actorScale /= 2;
+        if (key == GLFW_KEY_RIGHT_BRACKET)
+            params.actorScale *= 2;
+        if (key == GLFW_KEY_C)
+            params.captureToggled = true;
     }
+    if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+        const int2 screen = rparams.viewport->screenSize();
+        const float step = std::min(screen.x, screen.y) / 10.f;
+        if (key == GLFW_KEY_LEFT)
+            rparams.viewport->pan(step, 0);
+        if (key == GLFW_KEY_RIGHT)
+            rparams.viewport->pan(-step, 0);
+        if (key == GLFW_KEY_UP)
+            rparams.viewport->pan(0, step);
+        if (key == GLFW_KEY_DOWN)
+            rparams.viewport->pan(0, -step);
+        if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD)
+            rparams.viewport->zoom(1.25f, screen.x / 2.f, screen.y / 2.f);
+        if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT)
+            rparams.viewport->zoom(1 / 1.25f, screen.x / 2.f, screen.y / 2.f);
+    }
+}
+
+// Cursor position in framebuffer pixels, which differ from window coordinates on high DPI screens.
+static void cursor_framebuffer_position(GLFWwindow* wind, double x, double y, float &fx, float &fy)
+{
+    int windowWidth, windowHeight, width, height;
+    glfwGetWindowSize(wind, &windowWidth, &windowHeight);
+    glfwGetFramebufferSize(wind, &width, &height);
+    fx = static_cast<float>(windowWidth ? x * width / windowWidth : x);
+    fy = static_cast<float>(windowHeight ? y * height / windowHeight : y);
+}
+
+static void glfw_scroll_callback(GLFWwindow* wind, double xoffset, double yoffset)
+{
+    double x, y;
+    float fx, fy;
+    glfwGetCursorPos(wind, &x, &y);
+    cursor_framebuffer_position(wind, x, y, fx, fy);
+    rparams.viewport->zoom(std::pow(1.25f, static_cast<float>(yoffset)), fx, fy);
+}
+
+static void glfw_mouse_button_callback(GLFWwindow* wind, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+    {
+        rparams.dragging = action == GLFW_PRESS;
+        glfwGetCursorPos(wind, &rparams.cursorX, &rparams.cursorY);
+    }
+}
+
+static void glfw_cursor_pos_callback(GLFWwindow* wind, double x, double y)
+{
+    if (rparams.dragging)
+    {
+        float fx, fy, previousX, previousY;
+        cursor_framebuffer_position(wind, x, y, fx, fy);
+        cursor_framebuffer_position(wind, rparams.cursorX, rparams.cursorY, previousX, previousY);
+        rparams.viewport->pan(fx - previousX, fy - previousY);
+    }
+    rparams.cursorX = x;
+    rparams.cursorY = y;
 }
 
 static void glfw_framebuffer_size_callback(GLFWwindow* wind, int width, int height)
@@ -114,11 +218,106 @@ static void glfw_framebuffer_size_callback(GLFWwindow* wind, int width, int heig
     glViewport(0, 0, width, height);
 }
 
-void processTimeStep(int &generation, int runs);
+void processTimeStep(int runs);
 void renderFrame();
+void createOutput(const Context &context, int width, int height);
 
-int main()
+int main(int argc, char **argv)
 {
+    Settings settings;
+    try
+    {
+        settings = Settings::parse(argc, argv);
+    }
+    catch (const Exception &e)
+    {
+        cerr << e.what() << "\n" << Settings::usage();
+        return 2;
+    }
+    if (settings.help)
+    {
+        cout << Settings::usage();
+        return 0;
+    }
+    if (!settings.sweep.empty())
+    {
+        try
+        {
+            const int failed = SweepRunner(settings).run();
+            if (failed)
+                cerr << fmt::format("{} configurations failed", failed) << endl;
+            return failed ? 1 : 0;
+        }
+        catch (const Exception &e)
+        {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    if (!settings.strips.empty())
+    {
+        try
+        {
+            return StripRunner(settings).run();
+        }
+        catch (const cl::Error &error)
+        {
+            cerr << fmt::format("{}({})", error.what(), error.err()) << endl;
+            return 1;
+        }
+        catch (const Exception &e)
+        {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+
+    // A restored simulation brings its own board size and parameters.
+    std::unique_ptr<Checkpoint> checkpoint;
+    std::vector<Parameters> members;
+    try
+    {
+        if (!settings.restore.empty())
+        {
+            checkpoint = std::make_unique<Checkpoint>(settings.restore);
+            members = checkpoint->parameters();
+            settings.boardWidth = checkpoint->boardSize().x;
+            settings.boardHeight = checkpoint->boardSize().y;
+        }
+        else if (!settings.parameterTable.empty())
+            members = loadParameterTable(settings.parameterTable);
+    }
+    catch (const Exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if (settings.ensembleSize > 0 && !checkpoint)
+        members.resize(settings.ensembleSize, defaultParameters());
+    if (members.empty())
+        members.push_back(defaultParameters());
+    if (settings.actorCount && !checkpoint)
+        for (Parameters &p : members)
+            p.actorCount = std::max(*settings.actorCount, 0);
+    if (settings.displayMember < 0 || settings.displayMember >= static_cast<int>(members.size()))
+    {
+        cerr << fmt::format("--display={} is not an ensemble member", settings.displayMember) << "\n"
+             << Settings::usage();
+        return 1;
+    }
+    if (settings.checksumGenerations > 0)
+    {
+        try
+        {
+            return runChecksum(settings, members, checkpoint.get()) ? 1 : 0;
+        }
+        catch (const Exception &e)
+        {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+
     if (!glfwInit())
         return 255;
 
@@ -130,41 +329,14 @@ int main()
     glfwWindowHint(GLFW_BLUE_BITS   , mode->blueBits   );
     glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 
-    boardWidth  = mode->width - 100;
-    boardHeight = mode->height - 100;
-    float2 center{boardWidth / 2.f, boardHeight / 2.f};
-
-    std::mt19937_64 rng;
-    uint64_t timeSeed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    std::seed_seq ss{uint32_t(timeSeed & 0xffffffff), uint32_t(timeSeed>>32)};
-    rng.seed(ss);
-    std::uniform_real_distribution<double> unif(0, 1);
-
-    Board board(boardWidth, boardHeight);
-    for (int y = 0; y < boardHeight; ++y)
-        for (int x = 0; x < boardWidth; ++x)
-        {
-            const double divX = min(x, boardWidth - x);
-            const double divY = min(y, boardHeight - y);
-            const double div = 1 / divX + 1 / divY;
-            board(x, y).solid = div > .1;
-            board(x, y).trail = 0;
-        }
-
-    std::vector<Actor> actors(actorsCount, Actor{{0, 0}, 0, 0, false});
+    boardWidth  = settings.boardWidth ? settings.boardWidth : mode->width - 100;
+    boardHeight = settings.boardHeight ? settings.boardHeight : mode->height - 100;
+    // Boards larger than the screen are viewed through a zoomable window.
+    const int windowWidth = std::min(boardWidth, mode->width - 100);
+    const int windowHeight = std::min(boardHeight, mode->height - 100);
 
-
-    std::normal_distribution<> targetSpeedDistribution{.5, .1};
-    for (Actor &a : actors)
-    {
-        a.alive = true;
-        const double r = boardHeight / 2.1 * sqrt(unif(rng));
-        const double theta = unif(rng) * 2 * M_PI;
-        a.pos = {static_cast<float>(center.x + r * cos(theta)), static_cast<float>(center.y + r * sin(theta))};
-        a.speed = 0;
-        a.targetSpeed = targetSpeedDistribution(rng);
-        a.direction = unif(rng) * 2 * M_PI;
-    }
+    const uint64_t seed = settings.seed.value_or(settings.deterministic
+            ? 1 : std::chrono::high_resolution_clock::now().time_since_epoch().count());
 
     cout << fmt::format("C++ - sizeof(Cell) = {}, sizeof(Actor) = {}", sizeof(Cell), sizeof(Actor))  << endl;
 
@@ -172,7 +344,7 @@ int main()
 
     glfwSetErrorCallback(glfw_error_callback);
 
-    window = glfwCreateWindow(boardWidth, boardHeight, "Test", nullptr, nullptr);
+    window = glfwCreateWindow(windowWidth, windowHeight, "Test", nullptr, nullptr);
     if (!window)
     {
         glfwTerminate();
@@ -220,40 +392,38 @@ int main()
     }
     Context context(params.device, cps.data());
     // Create a command queue and use the first device
-    params.queue = CommandQueue(context, params.device);
-    params.boardProgram = getProgram(context, ASSETS_DIR"/Board.cl", errCode);
-    params.actorProgram = getProgram(context, ASSETS_DIR"/Actor.cl", errCode);
-
-    std::ostringstream options;
-    options << "-I " << std::string(ASSETS_DIR);
-
-    try
-    {
-        params.boardProgram.build(std::vector<Device>(1, params.device), options.str().c_str());
-    }
-    catch(Error error)
+    if (settings.profileInterval > 0 || !settings.trace.empty())
+        params.profiler = std::make_unique<Profiler>();
+    params.queue = CommandQueue(context, params.device, params.profiler ? CL_QUEUE_PROFILING_ENABLE : 0);
+    if (!settings.trace.empty())
     {
-        std::cout << error.what() << "(" << error.err() << ")\n"
-                  << "Log:\n" << params.boardProgram.getBuildInfo<CL_PROGRAM_BUILD_LOG>(params.device) << std::endl;
-        return 249;
+        // device intervals reach the trace through the profiler, which knows when they are complete
+        try
+        {
+            params.tracer = std::make_unique<Tracer>(settings.trace, params.queue);
+            params.profiler->setListener([](const std::string &name, cl_ulong start, cl_ulong end)
+            {
+                params.tracer->device(name, start, end);
+            });
+        }
+        catch (const Exception &e)
+        {
+            cout << e.what() << endl;
+        }
     }
 
-    try
-    {
-        params.actorProgram.build(std::vector<Device>(1, params.device), options.str().c_str());
-    }
-    catch(Error error)
-    {
-        std::cout << error.what() << "(" << error.err() << ")\n"
-                  << "Log:\n" << params.actorProgram.getBuildInfo<CL_PROGRAM_BUILD_LOG>(params.device) << std::endl;
-        return 249;
-    }
+    // The programs build in the background while the OpenGL side is set up.
+    const ProgramCache programCache(settings.programCache.value_or(ProgramCache::defaultDirectory()));
+    ProgramBuilder programBuilder(context, params.device, programCache);
+    const std::shared_future<Program> boardProgram = programBuilder.build(embeddedSource("Board.cl"));
+    const std::shared_future<Program> actorProgram = programBuilder.build(embeddedSource("Actor.cl"));
+    std::shared_future<Program> peakProgram;
+    if (settings.roofline)
+        peakProgram = programBuilder.build(embeddedSource("Peak.cl"));
 
-    params.boardKernel = Kernel(params.boardProgram, "board");
-    params.actorKernel = Kernel(params.actorProgram, "actor");
     // create opengl stuff
-    rparams.prg = initShaders(ASSETS_DIR "/Board.vert", ASSETS_DIR "/Board.frag");
-    rparams.tex = createTexture2D(boardWidth, boardHeight);
+    rparams.prg = initShaderSources(embeddedSource("Board.vert").source.c_str(),
+                                    embeddedSource("Board.frag").source.c_str());
     GLuint vbo  = createBuffer(12, vertices.data(), GL_STATIC_DRAW);
     GLuint tbo  = createBuffer(8,  texcords.data(), GL_STATIC_DRAW);
     GLuint ibo;
@@ -275,41 +445,294 @@ int main()
     // attach ibo
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glBindVertexArray(0);
-    // create opengl texture reference using opengl texture
-    params.tex = ImageGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, rparams.tex, &errCode);
-    if (errCode != CL_SUCCESS)
-        throw Exception(fmt::format( "Failed to create OpenGL texture refrence: {}", errCode));
-    params.cells = Buffer(context, CL_MEM_READ_WRITE, board.dataSize(), nullptr, &errCode);
-    if (errCode != CL_SUCCESS)
-        throw Exception(fmt::format( "Failed to create OpenGL texture refrence: {}", errCode));
-    params.actors = Buffer(context, CL_MEM_READ_WRITE, sizeof(Actor) * actors.size(), nullptr, &errCode);
-    if (errCode != CL_SUCCESS)
-        throw Exception(fmt::format( "Failed to create OpenGL texture refrence: {}", errCode));
-    params.actorSize = actors.size();
-
-    params.boardSize.x = boardWidth;
-    params.boardSize.y = boardHeight;
-
-    params.queue.enqueueWriteBuffer(params.cells, true, 0, board.dataSize(), board.cells().data());
-    params.queue.enqueueWriteBuffer(params.actors, true, 0, sizeof(Actor) * actors.size(), actors.data());
-    params.queue.finish();
+    try
+    {
+        params.boardProgram = boardProgram.get();
+        params.actorProgram = actorProgram.get();
+    }
+    catch(const Exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return 249;
+    }
+    params.simulation = std::make_unique<Simulation>(context, params.device, params.queue, params.boardProgram,
+                                                     params.actorProgram);
+    const int2 boardSize{boardWidth, boardHeight};
+    params.simulation->setDeterministic(settings.deterministic);
+    params.simulation->setSparse(settings.sparse);
+    params.simulation->setPyramid(settings.pyramidFrom, settings.pyramidInterval);
+    if (checkpoint)
+    {
+        checkpoint->restore(*params.simulation);
+        cout << fmt::format("Continuing {} at generation {}", settings.restore, checkpoint->generation()) << endl;
+        checkpoint.reset();
+    }
+    else
+        params.simulation->reset(boardSize, members, seed, SpawnRegion::centered(settings.spawn, boardSize));
+    // Keyframes from the current generation on belong to another run, unless continuing this one by seeking.
+    std::unique_ptr<KeyframeStore> keyframes;
+    try
+    {
+        if (!settings.keyframes.empty())
+        {
+            keyframes = std::make_unique<KeyframeStore>(context, settings.keyframes, settings.keyframeInterval,
+                                                        std::uintmax_t(settings.keyframeBudget) << 20);
+            if (settings.seek)
+                keyframes->seek(*params.simulation, *settings.seek);
+            else
+                keyframes->discardFrom(params.simulation->generation());
+        }
+    }
+    catch (const Exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+    params.simulation->setDisplayMember(settings.displayMember);
+    params.simulation->setProfiler(params.profiler.get());
+    std::optional<DevicePeak> devicePeak;
+    if (settings.roofline)
+    {
+        try
+        {
+            devicePeak = DevicePeak::measure(context, params.device, peakProgram.get());
+            cout << fmt::format("Device peaks: {:.1f} GB/s, {:.1f} GFLOP/s", devicePeak->bytesPerSecond * 1e-9,
+                                devicePeak->flopsPerSecond * 1e-9) << endl;
+        }
+        catch (const Exception &e)
+        {
+            cout << e.what() << endl;
+        }
+        catch (const Error &error)
+        {
+            cout << fmt::format("Measuring the device peaks failed: {}({})", error.what(), error.err()) << endl;
+        }
+    }
+    if (settings.tune)
+    {
+        LaunchTuner tuner(programCache.directory());
+        params.simulation->setLaunchShape(tuner.tune(context, params.device, params.boardProgram, params.actorProgram,
+                                                     boardSize, params.simulation->parameters(), settings.retune));
+    }
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    rparams.viewport = std::make_unique<Viewport>(boardSize, int2{framebufferWidth, framebufferHeight});
+    createOutput(context, framebufferWidth, framebufferHeight);
     glfwSetKeyCallback(window, glfw_key_callback);
     glfwSetFramebufferSizeCallback(window, glfw_framebuffer_size_callback);
+    glfwSetScrollCallback(window, glfw_scroll_callback);
+    glfwSetMouseButtonCallback(window, glfw_mouse_button_callback);
+    glfwSetCursorPosCallback(window, glfw_cursor_pos_callback);
+
+    auto lastProfile = std::chrono::steady_clock::now();
+
+    CheckpointWriter checkpointWriter(context);
+    int nextCheckpoint = params.simulation->generation() + settings.checkpointInterval;
+
+    // Snapshots are encoded on the pool while the simulation goes on.
+    ThreadPool snapshotPool;
+    std::future<void> snapshotWrite;
+
+    std::unique_ptr<FrameCapture> capture;
+    int captureSessions = 0;
+    params.captureToggled = !settings.capture.empty();
+
+    std::unique_ptr<TelemetryRecorder> telemetry;
+    int nextTelemetry = params.simulation->generation();
+    if (!settings.telemetry.empty())
+    {
+        try
+        {
+            telemetry = std::make_unique<TelemetryRecorder>(settings.telemetry);
+        }
+        catch (const Exception &e)
+        {
+            cout << e.what() << endl;
+        }
+    }
+
+    std::unique_ptr<KernelWatcher> kernelWatcher;
+    if (!settings.watchKernels.empty())
+        kernelWatcher = std::make_unique<KernelWatcher>(context, params.device, programCache, settings.watchKernels);
 
-    int generation = 0;
     while (!glfwWindowShouldClose(window))
     {
+        // swap in rebuilt kernels between frames
+        if (kernelWatcher)
+            if (const std::optional<KernelWatcher::Programs> programs = kernelWatcher->poll())
+            {
+                try
+                {
+                    params.simulation->setPrograms(programs->board, programs->actor);
+                    params.boardProgram = programs->board;
+                    params.actorProgram = programs->actor;
+                }
+                catch (const Exception &e)
+                {
+                    std::cout << e.what() << std::endl;
+                }
+            }
+        // the output texture follows the framebuffer, a minimized window has none
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        const int2 screen = rparams.viewport->screenSize();
+        if (framebufferWidth > 0 && framebufferHeight > 0
+                && (framebufferWidth != screen.x || framebufferHeight != screen.y))
+        {
+            createOutput(context, framebufferWidth, framebufferHeight);
+            // a video has one size
+            if (capture)
+                params.captureToggled = true;
+        }
+        if (params.captureToggled)
+        {
+            params.captureToggled = false;
+            if (capture)
+                capture.reset();
+            else
+            {
+                // later recordings get numbered instead of overwriting the first
+                std::filesystem::path path = settings.capture.empty() ? "capture.y4m" : settings.capture;
+                if (captureSessions++ > 0)
+                    path.replace_filename(fmt::format("{}-{}{}", path.stem().string(), captureSessions,
+                                                      path.extension().string()));
+                try
+                {
+                    capture = std::make_unique<FrameCapture>(path.string(), framebufferWidth, framebufferHeight);
+                }
+                catch (const Exception &e)
+                {
+                    cout << e.what() << endl;
+                }
+            }
+        }
         // process call
-        processTimeStep(generation, speed);
+        processTimeStep(speed);
+        // checkpoints are written in the background, a request while one is being written waits for the next frame
+        if (settings.checkpointInterval > 0 && params.simulation->generation() >= nextCheckpoint)
+            params.checkpointRequested = true;
+        if (params.checkpointRequested && checkpointWriter.save(*params.simulation, settings.checkpoint))
+        {
+            params.checkpointRequested = false;
+            nextCheckpoint = params.simulation->generation() + settings.checkpointInterval;
+        }
+        if (keyframes)
+            keyframes->record(*params.simulation);
+        // device times are collected as they complete and reported every few seconds
+        if (params.profiler)
+        {
+            const Tracer::Span span(params.tracer.get(), "profiler poll");
+            params.profiler->poll();
+            const auto now = std::chrono::steady_clock::now();
+            if (settings.profileInterval > 0
+                    && std::chrono::duration<double>(now - lastProfile).count() >= settings.profileInterval)
+            {
+                cout << params.profiler->report() << endl;
+                if (devicePeak)
+                    cout << rooflineReport(*params.profiler, *devicePeak, *params.simulation) << endl;
+                params.profiler->reset();
+                lastProfile = now;
+            }
+            // only there for the trace, which already has the intervals
+            else if (settings.profileInterval == 0)
+                params.profiler->reset();
+        }
+        // telemetry is reduced and read back without waiting, lines appear a frame or so later
+        if (telemetry)
+        {
+            if (params.simulation->generation() >= nextTelemetry)
+            {
+                telemetry->record(*params.simulation);
+                nextTelemetry = params.simulation->generation() + settings.telemetryInterval;
+            }
+            telemetry->poll();
+        }
+        if (params.actorScale != 1)
+        {
+            std::vector<int> counts;
+            for (const Parameters &p : params.simulation->parameters())
+                counts.push_back(std::min<std::int64_t>(std::max(1.f, p.actorCount * params.actorScale),
+                                                        std::numeric_limits<int>::max() / 2));
+            params.actorScale = 1;
+            try
+            {
+                const int2 size = params.simulation->boardSize();
+                params.simulation->setActorCounts(counts, seed, SpawnRegion::centered(settings.spawn, size));
+                cout << fmt::format("{} actors in member 0", counts[0]) << endl;
+            }
+            catch (const cl::Error &error)
+            {
+                cout << fmt::format("Changing the population failed: {}({})", error.what(), error.err()) << endl;
+            }
+        }
+        if (params.checksumRequested)
+        {
+            params.checksumRequested = false;
+            cout << fmt::format("Checksum {:016x} at generation {}", params.simulation->checksum(),
+                                params.simulation->generation()) << endl;
+        }
+        const bool snapshotBusy = snapshotWrite.valid()
+                && snapshotWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        if (params.snapshotRequested && params.simulation->displayMember() >= 0 && !snapshotBusy)
+        {
+            params.snapshotRequested = false;
+            auto cells = std::make_shared<std::vector<Cell>>();
+            params.simulation->readCells(params.simulation->displayMember(), *cells);
+            const std::string path = fmt::format("{}-{}.snapshot", settings.snapshotPrefix,
+                                                 params.simulation->generation());
+            snapshotWrite = std::async(std::launch::async, [cells, path, &snapshotPool,
+                                                            boardSize = params.simulation->boardSize(),
+                                                            member = params.simulation->displayMember(),
+                                                            generation = params.simulation->generation()]()
+            {
+                try
+                {
+                    writeSnapshot(path, *cells, boardSize, member, generation, snapshotPool);
+                    cout << fmt::format("Snapshot written to {}", path) << endl;
+                }
+                catch (const Exception &e)
+                {
+                    cout << e.what() << endl;
+                }
+            });
+        }
         // render call
-        renderFrame();
+        {
+            const Tracer::Span span(params.tracer.get(), "renderFrame");
+            renderFrame();
+        }
+        if (capture)
+        {
+            const Tracer::Span span(params.tracer.get(), "capture");
+            capture->capture();
+        }
         // swap front and back buffers
-        glfwSwapBuffers(window);
+        {
+            const Tracer::Span span(params.tracer.get(), "glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         // poll for events
-        glfwPollEvents();
+        {
+            const Tracer::Span span(params.tracer.get(), "glfwPollEvents");
+            glfwPollEvents();
+        }
 
     }
 
+    capture.reset();
+    telemetry.reset();
+    keyframes.reset();
+    kernelWatcher.reset();
+    if (params.profiler)
+    {
+        params.profiler->poll(true);
+        if (settings.profileInterval > 0)
+            cout << params.profiler->report() << endl;
+        if (devicePeak)
+            cout << rooflineReport(*params.profiler, *devicePeak, *params.simulation) << endl;
+        params.profiler.reset();
+    }
+    params.simulation.reset();
+    params.tracer.reset();
     glfwDestroyWindow(window);
 
     glfwTerminate();
@@ -321,48 +744,48 @@ inline unsigned divup(unsigned a, unsigned b)
     return (a + b - 1) / b;
 }
 
-void processTimeStep(int &generation, int runs)
+void processTimeStep(int runs)
 {
+    const Tracer::Span span(params.tracer.get(), "processTimeStep");
     cl::Event ev;
-    glFinish();
+    {
+        const Tracer::Span glSpan(params.tracer.get(), "glFinish");
+        glFinish();
+    }
 
     std::vector<Memory> objs;
     objs.clear();
     objs.push_back(params.tex);
     // flush opengl commands and wait for object acquisition
-    cl_int res = params.queue.enqueueAcquireGLObjects(&objs, nullptr, &ev);
-    ev.wait();
+    cl_int res;
+    {
+        const Tracer::Span acquireSpan(params.tracer.get(), "acquire");
+        res = params.queue.enqueueAcquireGLObjects(&objs, nullptr, &ev);
+        ev.wait();
+    }
     if (res != CL_SUCCESS)
         throw Exception(fmt::format( "Failed acquiring GL object: {}", res));
+    if (params.profiler)
+        params.profiler->add("acquire", ev);
 
-    const NDRange localActor = NDRange(16);
-    const NDRange globalActor = NDRange(localActor[0] * divup(params.actorSize, localActor[0]));
-    params.actorKernel.setArg(0, params.cells);
-    params.actorKernel.setArg(1, params.boardSize);
-    params.actorKernel.setArg(2, params.actors);
-    params.actorKernel.setArg(3, params.actorSize);
-
-    const NDRange localBoard(16, 16);
-    const NDRange globalBoard(localBoard[0] * divup(params.boardSize.x, localBoard[0]),
-                        localBoard[1] * divup(params.boardSize.y, localBoard[1]));
-    params.boardKernel.setArg(0, params.tex);
-    params.boardKernel.setArg(1, params.cells);
-    params.boardKernel.setArg(2, params.boardSize);
-
-    for (int i = 0; i < runs; ++i)
     {
-        params.actorKernel.setArg(4, generation);
-        params.queue.enqueueNDRangeKernel(params.actorKernel, cl::NullRange, globalActor, localActor);
-        params.queue.enqueueNDRangeKernel(params.boardKernel, cl::NullRange, globalBoard, localBoard);
-        ++generation;
+        const Tracer::Span enqueueSpan(params.tracer.get(), "enqueue");
+        params.simulation->step(runs);
+        params.simulation->setView(rparams.viewport->origin(), rparams.viewport->scale());
+        params.simulation->draw();
     }
     // release opengl object
-    res = params.queue.enqueueReleaseGLObjects(&objs);
-
-    ev.wait();
+    {
+        const Tracer::Span releaseSpan(params.tracer.get(), "release");
+        res = params.queue.enqueueReleaseGLObjects(&objs, nullptr, params.profiler ? &ev : nullptr);
+        ev.wait();
+    }
     if (res!=CL_SUCCESS)
         throw Exception(fmt::format( "Failed releasing GL object: {}", res));
+    if (params.profiler)
+        params.profiler->add("release", ev);
 
+    const Tracer::Span finishSpan(params.tracer.get(), "finish");
     params.queue.finish();
 }
 
@@ -380,7 +803,6 @@ void renderFrame()
     glActiveTexture(GL_TEXTURE0);
     glUniform1i(tex_loc, 0);
     glBindTexture(GL_TEXTURE_2D, rparams.tex);
-    glGenerateMipmap(GL_TEXTURE_2D);
     // set project matrix
     glUniformMatrix4fv(mat_loc, 1, GL_FALSE, matrix.data());
     // now render stuff
@@ -388,3 +810,21 @@ void renderFrame()
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
     glBindVertexArray(0);
 }
+
+void createOutput(const Context &context, int width, int height)
+{
+    // the old texture may still be in use by queued kernels
+    params.queue.finish();
+    params.tex = ImageGL();
+    if (rparams.tex)
+        glDeleteTextures(1, &rparams.tex);
+
+    rparams.tex = createTexture2D(width, height);
+    // create opengl texture reference using opengl texture
+    cl_int errCode;
+    params.tex = ImageGL(context, CL_MEM_READ_WRITE, GL_TEXTURE_2D, 0, rparams.tex, &errCode);
+    if (errCode != CL_SUCCESS)
+        throw Exception(fmt::format( "Failed to create OpenGL texture refrence: {}", errCode));
+    params.simulation->setOutput(params.tex, params.simulation->displayMember());
+    rparams.viewport->setScreenSize({width, height});
+}